@@ -5,28 +5,89 @@
 #include "liblesma/Common/LesmaVersion.h"
 #include "liblesma/Common/Utils.h"
 #include "liblesma/Driver/Driver.h"
+#include "liblesma/Driver/Server.h"
 
 using namespace lesma;
 
+std::optional<OptimizationLevel> getOptimizationLevel(const std::string &level) {
+    if (level == "0")
+        return OptimizationLevel::O0;
+    else if (level == "1")
+        return OptimizationLevel::O1;
+    else if (level == "2")
+        return OptimizationLevel::O2;
+    else if (level == "3")
+        return OptimizationLevel::O3;
+    else if (level == "s")
+        return OptimizationLevel::Os;
+    else if (level == "z")
+        return OptimizationLevel::Oz;
+
+    return std::nullopt;
+}
+
+LTOKind getLTOKind(const std::string &lto) {
+    if (lto == "full")
+        return LTOKind::Full;
+    else if (lto == "thin")
+        return LTOKind::Thin;
+
+    return LTOKind::None;
+}
+
 std::unique_ptr<CLIOptions> parseCLI(int argc, char **argv) {
     bool debug = false;
     bool timer = false;
+    unsigned partitions = 1;
+    bool lazy = false;
+    std::string optimization;
+    std::string cpu = "generic";
+    std::string features;
+    std::vector<std::string> multiversion;
+    std::string lto;
+    std::string server;
+    std::string socket = Server::getDefaultSocket();
     std::string output = "output";
-    std::string file;
+    unsigned jobs = 0;
+    bool incremental = false;
+    std::string time_trace;
+    unsigned time_trace_granularity = 500;
+    bool mem_report = false;
+    std::string cache_dir = getCacheDir();
+    std::vector<std::string> files;
 
     CLI::App app{"Lesma programming language", "lesma"};
     app.set_version_flag("-v,--version", LESMA_VERSION, "Print the Lesma version");
     app.set_help_all_flag("-s,--subcommands", "Expand help to show subcommand flags and options");
     app.add_flag("-d,--debug", debug, "Enable debug logging");
     app.add_flag("-t,--timer", timer, "Enable compiler timer");
+    app.add_option("--cpu", cpu, "Target CPU, native for the host CPU");
+    app.add_option("--features", features, "Target features, e.g. +avx2,-avx512f, or native for the host features");
+    app.add_option("--server", server, "Forward the command to a compile server listening on the socket");
+    app.add_option("--time-trace", time_trace, "Write a Chrome trace of the compiler phases and LLVM passes to the file");
+    app.add_option("--time-trace-granularity", time_trace_granularity, "Minimum duration of the traced events, in microseconds, defaults to 500");
+    app.add_flag("--mem-report", mem_report, "Report the memory used by each phase and category of objects");
+    app.add_option("--cache-dir", cache_dir, "Directory of the module, object and linker caches, defaults to ~/.lesma/cache");
 
     CLI::App *run = app.add_subcommand("run", "Run source code");
     CLI::App *compile = app.add_subcommand("compile", "Compile source code");
+    CLI::App *repl = app.add_subcommand("repl", "Run source code interactively");
+    CLI::App *serve = app.add_subcommand("serve", "Serve run and compile commands on a Unix socket, with the standard library kept compiled");
     app.require_subcommand();
 
-    run->add_option("file", file, "Lesma source filename")->required();
-    compile->add_option("file", file, "Lesma source filename")->required();
-    compile->add_option("-o,--output", output, "Output filename");
+    run->add_option("file", files, "Lesma source filename")->required()->expected(1);
+    run->add_flag("--lazy", lazy, "Compile functions only when they're first called");
+    run->add_option("-O", optimization, "Optimization level, defaults to a fast pipeline")->check(CLI::IsMember({"0", "1", "2", "3", "s", "z"}));
+    compile->add_option("files", files, "Lesma source filenames")->required();
+    auto output_option = compile->add_option("-o,--output", output, "Output filename, or output directory when compiling several files");
+    compile->add_option("-j,--jobs", jobs, "Number of files compiled in parallel, defaults to the number of cores");
+    compile->add_option("-O", optimization, "Optimization level, defaults to 3")->check(CLI::IsMember({"0", "1", "2", "3", "s", "z"}));
+    compile->add_option("--partitions", partitions, "Split the module into partitions optimized and compiled in parallel")->check(CLI::PositiveNumber);
+    auto incremental_flag = compile->add_flag("--incremental", incremental, "Compile only the functions which changed since the previous build, without inlining between them");
+    compile->add_option("--multiversion", multiversion, "Also compile the functions for CPUs with these features, e.g. avx2,avx512f, picked when the program starts")->delimiter(',')->excludes(incremental_flag);
+    compile->add_option("--lto", lto, "Optimize all modules together at link time, by linking them or with ThinLTO")->check(CLI::IsMember({"full", "thin"}));
+    repl->add_option("-O", optimization, "Optimization level, defaults to a fast pipeline")->check(CLI::IsMember({"0", "1", "2", "3", "s", "z"}));
+    serve->add_option("--socket", socket, "Path of the Unix socket");
 
     try {
         app.parse(argc, argv);
@@ -39,13 +100,79 @@ std::unique_ptr<CLIOptions> parseCLI(int argc, char **argv) {
         }
     }
 
-    return std::make_unique<CLIOptions>(CLIOptions{std::filesystem::absolute(file), output, debug, timer, run->parsed()});
+    // Several programs are named after their source, in the current directory by default
+    if (files.size() > 1 && output_option->count() == 0)
+        output = ".";
+
+    for (auto &file: files)
+        file = std::filesystem::absolute(file);
+
+    return std::make_unique<CLIOptions>(CLIOptions{files, output, debug, timer, run->parsed(), partitions, lazy, optimization, cpu, features, multiversion, lto, serve->parsed(), socket, server, jobs, incremental, repl->parsed(), time_trace, time_trace_granularity, mem_report, cache_dir});
+}
+
+std::unique_ptr<Options> getDriverOptions(const CLIOptions &options, const std::string &file, const std::string &output) {
+    return std::make_unique<Options>(Options{SourceType::FILE, file,
+                                             static_cast<Debug>(options.debug ? (LEXER | AST | IR) : NONE), output, options.timer,
+                                             options.partitions, options.lazy, getOptimizationLevel(options.optimization),
+                                             options.cpu, options.features, options.multiversion, getLTOKind(options.lto), options.incremental,
+                                             options.time_trace, options.time_trace_granularity, options.mem_report, 0, options.cache_dir});
+}
+
+int execute(const CLIOptions &options) {
+    if (options.repl)
+        return Driver::Repl(getDriverOptions(options, "", ""));
+    if (options.jit)
+        return Driver::Run(getDriverOptions(options, options.files.front(), options.output));
+    if (options.files.size() == 1)
+        return Driver::Compile(getDriverOptions(options, options.files.front(), options.output));
+
+    std::vector<std::unique_ptr<Options>> driver_options;
+    for (const auto &file: options.files)
+        driver_options.push_back(getDriverOptions(options, file, fmt::format("{}/{}", options.output, getBasename(file))));
+
+    return Driver::CompileAll(std::move(driver_options), options.jobs);
+}
+
+int serve(const std::string &socket) {
+    Driver::Warm();
+
+    return Server::Serve(socket, [](const std::vector<std::string> &args) {
+        std::vector<char *> argv;
+        for (const auto &arg: args)
+            argv.push_back(const_cast<char *>(arg.c_str()));
+
+        auto options = parseCLI(static_cast<int>(argv.size()), argv.data());
+        if (options->serve) {
+            print(ERROR, "A server can't be started by a request\n");
+            return 1;
+        }
+
+        return execute(*options);
+    });
 }
 
 int main(int argc, char **argv) {
     // CLI Parsing
     auto options = parseCLI(argc, argv);
-    auto driver_options = std::make_unique<Options>(Options{SourceType::FILE, options->file,
-                                                            static_cast<Debug>(options->debug ? (LEXER | AST | IR) : NONE), options->output, options->timer});
-    return options->jit ? Driver::Run(std::move(driver_options)) : Driver::Compile(std::move(driver_options));
+    if (options->serve)
+        return serve(options->socket);
+
+    // Forward the command without the server option, or compile it locally if no server is listening
+    if (!options->server.empty()) {
+        std::vector<std::string> args;
+        for (int i = 0; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--server")
+                i++;
+            else if (arg.rfind("--server=", 0) != 0)
+                args.push_back(arg);
+        }
+
+        if (auto exit_code = Server::Forward(options->server, args))
+            return *exit_code;
+
+        print(WARNING, "No server is listening on {}, compiling locally\n", options->server);
+    }
+
+    return execute(*options);
 }
\ No newline at end of file
@@ -7,13 +7,14 @@
 #include <vector>
 
 #include "liblesma/AST/ASTVisitor.h"
+#include "liblesma/Common/MemoryReport.h"
 #include "liblesma/Common/Utils.h"
 #include "liblesma/Token/Token.h"
 #include "liblesma/Token/TokenType.h"
 #include "nameof.hpp"
 
 namespace lesma {
-    class AST {
+    class AST : public MemoryTracked<MemoryCategory::ASTNodes> {
         llvm::SMRange Loc;
 
     public:
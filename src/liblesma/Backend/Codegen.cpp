@@ -2,37 +2,44 @@
 
 using namespace lesma;
 
-Codegen::Codegen(std::shared_ptr<Parser> parser, std::shared_ptr<SourceMgr> srcMgr, const std::string &filename, std::vector<std::string> imports, bool jit, bool main, std::string alias, const std::shared_ptr<ThreadSafeContext> &context) {
-    InitializeNativeTarget();
-    InitializeNativeTargetAsmPrinter();
-    InitializeNativeTargetAsmParser();
+Codegen::Codegen(std::shared_ptr<Parser> parser, std::shared_ptr<SourceMgr> srcMgr, const std::string &filename, std::shared_ptr<ModuleGraph> graph, bool jit, bool main, std::string alias, const std::shared_ptr<ThreadSafeContext> &context) {
+    InitializeTargets();
 
+    // The module is named after its source, ThinLTO can't read the summary of a module without a source filename
+    this->alias = std::move(alias);
+    this->filename = filename;
+
+    Graph = graph == nullptr ? std::make_shared<ModuleGraph>() : std::move(graph);
     TheContext = context == nullptr ? std::make_shared<ThreadSafeContext>(std::make_unique<LLVMContext>()) : context;
-    TargetMachine = InitializeTargetMachine();
+    TargetMachine = InitializeTargetMachine(*Graph);
     TheModule = InitializeModule();
-    if (jit) {
-        TheJIT = InitializeJIT();
-    }
 
     Builder = std::make_unique<IRBuilder<>>(*TheContext->getContext());
     Parser_ = std::move(parser);
     SourceManager = std::move(srcMgr);
     Scope = new SymbolTable(nullptr);
 
-    this->alias = std::move(alias);
-    this->filename = filename;
     isMain = main;
     isJIT = jit;
 
-    ImportedModules = std::move(imports);
     TopLevelFunc = InitializeTopLevel();
 
-    // If it's not base.les stdlib, then import it
-    if (std::filesystem::absolute(filename) != getStdDir() + "base.les") {
+    // If it's not base.les stdlib, then import it, sources without a file like REPL inputs always do
+    if (filename.empty() || std::filesystem::absolute(filename) != getStdDir() + "base.les") {
         CompileModule(llvm::SMRange(), getStdDir() + "base.les", true, "base", true, true, {});
     }
 }
 
+void Codegen::InitializeTargets() {
+    // Modules can be compiled in parallel, the targets are registered once
+    static std::once_flag targets_initialized;
+    std::call_once(targets_initialized, [] {
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+        InitializeNativeTargetAsmParser();
+    });
+}
+
 std::unique_ptr<Module> Codegen::InitializeModule() {
     auto mod = std::make_unique<Module>("Lesma", *TheContext->getContext());
     mod->setTargetTriple(TargetMachine->getTargetTriple().str());
@@ -42,10 +49,9 @@ std::unique_ptr<Module> Codegen::InitializeModule() {
     return mod;
 }
 
-std::unique_ptr<llvm::TargetMachine> Codegen::InitializeTargetMachine() {
+std::unique_ptr<llvm::TargetMachine> Codegen::InitializeTargetMachine(const ModuleGraph &graph) {
     // Configure output target
-    auto targetTriple = llvm::Triple(llvm::sys::getDefaultTargetTriple());
-    const std::string &tripletString = targetTriple.getTriple();
+    const std::string &tripletString = graph.getTriple();
 
     // Search after selected target
     std::string error;
@@ -55,15 +61,39 @@ std::unique_ptr<llvm::TargetMachine> Codegen::InitializeTargetMachine() {
 
     llvm::TargetOptions opt;
     llvm::Reloc::Model rm = llvm::Reloc::Model();
-    std::unique_ptr<llvm::TargetMachine> target_machine(target->createTargetMachine(tripletString, "generic", "", opt, rm));
+    std::unique_ptr<llvm::TargetMachine> target_machine(target->createTargetMachine(tripletString, graph.getCPU(), graph.getFeatures(), opt, rm, llvm::None, graph.getCodeGenOptLevel()));
     return target_machine;
 }
 
-std::unique_ptr<LLJIT> Codegen::InitializeJIT() {
-    llvm::orc::LLJITBuilder builder;
-    builder.setDataLayout(TheModule->getDataLayout());
-    builder.setJITTargetMachineBuilder(llvm::orc::JITTargetMachineBuilder(TargetMachine->getTargetTriple()));
-    auto jit = llvm::cantFail(builder.create());
+std::unique_ptr<LLJIT> Codegen::InitializeJIT(bool lazy) {
+    auto target_machine_builder = llvm::orc::JITTargetMachineBuilder(TargetMachine->getTargetTriple());
+    target_machine_builder.setCPU(Graph->getCPU());
+    target_machine_builder.getFeatures() = llvm::SubtargetFeatures(Graph->getFeatures());
+    target_machine_builder.setCodeGenOptLevel(Graph->getCodeGenOptLevel());
+
+    // Compiled objects are cached on disk, so unchanged modules are only loaded and linked next time
+    JITCache = std::make_unique<JITObjectCache>(fmt::format("{}-O{}", Graph->getTarget(), static_cast<int>(Graph->getCodeGenOptLevel())),
+                                                fmt::format("{}/jit", Graph->getCacheDirectory()));
+    auto compileFunction = [this](JITTargetMachineBuilder builder) -> Expected<std::unique_ptr<IRCompileLayer::IRCompiler>> {
+        return std::make_unique<ConcurrentIRCompiler>(std::move(builder), JITCache.get());
+    };
+
+    std::unique_ptr<LLJIT> jit;
+    if (lazy) {
+        // Functions are compiled when they're first called, through lazy reexports
+        llvm::orc::LLLazyJITBuilder builder;
+        builder.setDataLayout(TheModule->getDataLayout());
+        builder.setJITTargetMachineBuilder(target_machine_builder);
+        builder.setCompileFunctionCreator(compileFunction);
+        jit = llvm::cantFail(builder.create());
+    } else {
+        llvm::orc::LLJITBuilder builder;
+        builder.setDataLayout(TheModule->getDataLayout());
+        builder.setJITTargetMachineBuilder(target_machine_builder);
+        builder.setCompileFunctionCreator(compileFunction);
+        jit = llvm::cantFail(builder.create());
+    }
+
     if (!jit) {
         throw CodegenError({}, "Couldn't initialize JIT\n");
     }
@@ -157,131 +187,324 @@ void Codegen::defineFunction(lesma::Value *value, const FuncDecl *node, Value *c
 }
 
 void Codegen::CompileModule(llvm::SMRange span, const std::string &filepath, bool isStd, const std::string &module_alias, bool importAll, bool importToScope, const std::vector<std::pair<std::string, std::string>> &imported_names) {
-    std::filesystem::path mainPath = filename;
-    // Read source
-    auto absolute_path = isStd ? filepath : fmt::format("{}/{}", std::filesystem::absolute(mainPath).parent_path().c_str(), filepath);
-
-    // If module is already imported, don't compile again
-    // TODO: Re-enable this again, currently it destroys nested imports
-    //    if (std::find(ImportedModules.begin(), ImportedModules.end(), absolute_path) != ImportedModules.end())
-    //        return;
+    auto absolute_path = ModuleGraph::getImportPath(filename, filepath, isStd);
+    auto mangling_alias = ModuleGraph::getImportAlias(module_alias, importToScope);
+
+    // If module is already imported, reuse its interface instead of compiling it again
+    auto node = Graph->Find(absolute_path, mangling_alias);
+    if (node != nullptr && !node->interface.has_value())
+        throw CodegenError(span, "Circular import of {}", filepath);
+
+    // Modules that weren't discovered by the driver are compiled on demand
+    if (node == nullptr) {
+        node = Graph->Load(absolute_path, mangling_alias);
+
+        try {
+            CompileNode(Graph, *node, isJIT);
+        } catch (const LesmaError &) {
+            throw CodegenError(span, "Unable to import {} due to errors", filepath);
+        }
+    }
 
-    auto buffer = MemoryBuffer::getFile(absolute_path);
-    if (std::error_code ec = buffer.getError())
-        throw LesmaError(llvm::SMRange(), "Could not read file: {}", absolute_path);
+    Dependencies.push_back({node->path, node->alias, node->key});
+    ImportInterface(*node->interface, module_alias, importAll, importToScope, imported_names);
+}
 
-    auto file_id = SourceManager->AddNewSourceBuffer(std::move(*buffer), llvm::SMLoc());
-    auto source_str = SourceManager->getMemoryBuffer(file_id)->getBuffer().str();
-    ImportedModules.push_back(absolute_path);
+/**
+ * Compile an imported module in its own context, or load it from the cache if neither it nor its imports changed,
+ * and add it to the graph to be linked or added to the JIT. With link time optimization, the module is kept as bitcode
+ * to be optimized together with the main module. The modules it imports must already be compiled.
+ *
+ * @param graph Graph of the current compilation
+ * @param node Module to compile
+ * @param jit Whether the module will be executed by the JIT
+ */
+void Codegen::CompileNode(const std::shared_ptr<ModuleGraph> &graph, ModuleNode &node, bool jit) {
+    auto context = std::make_shared<ThreadSafeContext>(std::make_unique<LLVMContext>());
+    auto bitcode = jit || graph->getLTO() != LTOKind::None;
+    ModuleCache cache(graph->getCacheDirectory());
+    llvm::TimeTraceScope module_scope("Module", node.path);
 
     try {
-        // Lexer
-        auto lexer = std::make_unique<Lexer>(SourceManager);
-        lexer->ScanAll();
-
-        // Parser
-        auto parser = std::make_unique<Parser>(lexer->getTokens());
-        parser->Parse();
-
-        // TODO: Delete it, memory leak, smart pointer made us lose the references to other modules
-        // Codegen
-        auto codegen = std::make_unique<Codegen>(std::move(parser), SourceManager, absolute_path, ImportedModules, isJIT, false, !importToScope ? module_alias : "", TheContext);
-        codegen->Run();
-
-        // Optimize
-        codegen->Optimize(OptimizationLevel::O3);
-        codegen->TheModule->setModuleIdentifier(filepath);
-
-        ImportedModules = std::move(codegen->ImportedModules);
-
-        if (!importToScope) {
-            auto import_typ = new Type(TY_IMPORT);
-            auto import_sym = new Value(module_alias, import_typ);
-            Scope->insertSymbol(import_sym);
-            Scope->insertType(module_alias, import_typ);
+        auto interface = cache.LoadInterface(node.key);
+        if (interface.has_value() && !cache.IsUpToDate(*interface, graph->getTarget(), graph->getOptimizationLevel(), graph->getLTO()))
+            interface.reset();
+
+        std::unique_ptr<Module> module;
+        if (interface.has_value() && (bitcode || !cache.HasObject(node.key))) {
+            module = cache.LoadModule(node.key, *context->getContext());
+            if (module == nullptr)
+                interface.reset();
         }
 
-        auto findInImports = [imported_names](const std::string &import) -> std::string {
-            for (const auto &imp_pair: imported_names) {
-                if (imp_pair.first == import)
-                    return imp_pair.second;
-            }
+        if (!interface.has_value()) {
+            // Lexer, scanned while parsing
+            Lexer lexer(node.sourceMgr);
 
-            return "";
-        };
+            // Parser
+            auto parser = std::make_unique<Parser>(lexer);
+            {
+                llvm::TimeTraceScope scope("Parse", node.path);
+                parser->Parse();
+            }
 
-        if (isJIT) {
-            // Add the module to JIT
-            cantFail(TheJIT->addIRModule(ThreadSafeModule(std::move(codegen->TheModule), *TheContext)), fmt::format("Failed adding import {} to JIT", filename).c_str());
-        } else {
-            // Create object file to be linked
-            std::string obj_file = fmt::format("tmp{}", ObjectFiles.size());
-            codegen->WriteToObjectFile(obj_file);
-            ObjectFiles.push_back(fmt::format("{}.o", obj_file));
-        }
+            // Codegen
+            auto codegen = std::make_unique<Codegen>(std::move(parser), node.sourceMgr, node.path, graph, jit, false, node.alias, context);
+            {
+                llvm::TimeTraceScope scope("Codegen", node.path);
+                codegen->Run();
+            }
 
-        // Import Symbols
-        for (auto sym: codegen->Scope->getSymbols()) {
-            auto imp_alias = findInImports(sym.first);
-            if (sym.second->getType()->isOneOf({TY_ENUM, TY_CLASS}) && sym.second->isExported() && (importAll || !imp_alias.empty())) {
-                llvm::StructType *structType = StructType::getTypeByName(*TheContext->getContext(), sym.first);
-
-                auto *structSymbol = new Value(imp_alias.empty() ? sym.first : imp_alias, sym.second->getType());
-                structSymbol->getType()->setLLVMType(structType);
-                Scope->insertType(sym.first, sym.second->getType());
-                Scope->insertSymbol(structSymbol);
-            } else if (sym.second->getType()->is(TY_FUNCTION) && sym.second->isExported()) {
-                auto *F = llvm::dyn_cast<Function>(sym.second->getLLVMValue());
-                auto *FTy = llvm::cast<FunctionType>(sym.second->getType()->getLLVMType());
-
-                if (isJIT) {
-                    // Insert the function declaration, since we linked the modules earlier
-                    F = llvm::cast<Function>(TheModule->getOrInsertFunction(sym.second->getMangledName(), FTy).getCallee());
-                }
+            // Collect the exported symbols before optimizations remove unused values
+            interface = ModuleInterface::Create(codegen->Scope, codegen->Dependencies);
 
-                auto name = std::string{sym.first};
-                std::vector<lesma::Type *> paramTypes;
-                for (auto field: sym.second->getType()->getFields()) {
-                    paramTypes.push_back(field->type);
-                }
+            // Optimize
+            {
+                llvm::TimeTraceScope scope("Optimize", node.path);
+                codegen->Optimize(graph->getOptimizationLevel());
+            }
+            module = std::move(codegen->TheModule);
 
-                Value *func_symbol = codegen->Scope->lookupFunction(name, paramTypes);
-
-                // Only import if it's exported
-                imp_alias = findInImports(name);
-                // TODO: methods should only be imported if they class is in the imports specified
-                if (func_symbol != nullptr && func_symbol->isExported() && (importAll || !imp_alias.empty() || isMethod(sym.second->getMangledName()))) {
-                    auto symbol = new Value(imp_alias.empty() ? name : std::regex_replace(name, std::regex(name), imp_alias), func_symbol->getType());
-
-                    if (isJIT) {
-                        symbol->getType()->setLLVMType(FTy);
-                        symbol->setLLVMValue(F);
-                        symbol->setExported(false);
-                        symbol->setMangledName(sym.second->getMangledName());
-                    } else {
-                        // If it's compiled, we need to make a new Function declaration in the importing file
-                        auto new_func = Function::Create(FTy, Function::ExternalLinkage, sym.second->getMangledName(), *TheModule);
-                        symbol->getType()->setLLVMType(new_func->getFunctionType());
-                        symbol->setLLVMValue(new_func);
-                        symbol->setExported(false);
-                        symbol->setMangledName(sym.second->getMangledName());
-                    }
+            cache.Store(node.key, *module, *interface);
+        }
 
-                    Scope->insertSymbol(symbol);
-                }
-            }
+        if (bitcode) {
+            module->setModuleIdentifier(node.path);
+            graph->AddModule(ThreadSafeModule(std::move(module), *context));
+        } else if (module == nullptr) {
+            // Link the cached object file
+            graph->AddObjectFile(cache.getObjectPath(node.key));
+        } else {
+            llvm::TimeTraceScope scope("Emit", node.path);
+            llvm::SmallVector<char, 0> object;
+            llvm::raw_svector_ostream out(object);
+            WriteToObjectFile(*InitializeTargetMachine(*graph), *module, out);
+
+            // Fallback to linking the object from memory
+            if (cache.StoreObject(node.key, {object.data(), object.size()}))
+                graph->AddObjectFile(cache.getObjectPath(node.key));
+            else
+                graph->AddObject(std::move(object));
         }
+
+        node.interface = std::move(interface);
     } catch (const LesmaError &err) {
+        // Modules can be compiled in parallel, don't interleave their errors
+        static std::mutex print_mutex;
+        std::lock_guard<std::mutex> lock(print_mutex);
+
         if (!err.getSpan().isValid())
             print(ERROR, err.what());
         else
-            showInline(SourceManager.get(), file_id, err.getSpan(), err.what(), absolute_path, true);
+            showInline(node.sourceMgr.get(), 1, err.getSpan(), err.what(), node.path, true);
 
-        throw CodegenError(span, "Unable to import {} due to errors", filepath);
+        throw;
+    }
+}
+
+void Codegen::ImportInterface(const ModuleInterface &interface, const std::string &module_alias, bool importAll, bool importToScope, const std::vector<std::pair<std::string, std::string>> &imported_names) {
+    if (!importToScope) {
+        auto import_typ = new Type(TY_IMPORT);
+        auto import_sym = new Value(module_alias, import_typ);
+        Scope->insertSymbol(import_sym);
+        Scope->insertType(module_alias, import_typ);
+    }
+
+    auto findInImports = [imported_names](const std::string &import) -> std::string {
+        for (const auto &imp_pair: imported_names) {
+            if (imp_pair.first == import)
+                return imp_pair.second;
+        }
+
+        return "";
+    };
+
+    // Import Symbols
+    for (auto sym: interface.Materialize(*TheModule)) {
+        auto name = sym->getName();
+        auto imp_alias = findInImports(name);
+        if (sym->getType()->isOneOf({TY_ENUM, TY_CLASS}) && (importAll || !imp_alias.empty())) {
+            auto *structSymbol = new Value(imp_alias.empty() ? name : imp_alias, sym->getType());
+            Scope->insertType(name, sym->getType());
+            Scope->insertSymbol(structSymbol);
+        } else if (sym->getType()->is(TY_FUNCTION)) {
+            // TODO: methods should only be imported if they class is in the imports specified
+            if (!importAll && imp_alias.empty() && !isMethod(sym->getMangledName()))
+                continue;
+
+            // Declare the function in the importing module, the definition is linked later
+            auto *FTy = llvm::cast<FunctionType>(sym->getType()->getLLVMType());
+            auto *F = llvm::cast<Function>(TheModule->getOrInsertFunction(sym->getMangledName(), FTy).getCallee());
+
+            auto symbol = new Value(imp_alias.empty() ? name : imp_alias, sym->getType(), F);
+            symbol->setExported(false);
+            symbol->setMangledName(sym->getMangledName());
+
+            Scope->insertSymbol(symbol);
+        }
+    }
+}
+
+/**
+ * Get the features of the host CPU, used to compile for it with the native CPU
+ *
+ * @return Features in the format of the target machine, e.g. +avx2,-avx512f
+ */
+std::string Codegen::getHostCPUFeatures() {
+    llvm::SubtargetFeatures features;
+    llvm::StringMap<bool> host_features;
+    if (llvm::sys::getHostCPUFeatures(host_features)) {
+        for (auto &feature: host_features)
+            features.AddFeature(feature.first(), feature.second);
+    }
+
+    return features.getString();
+}
+
+llvm::CodeGenOpt::Level Codegen::getCodeGenOptLevel(OptimizationLevel opt) {
+    switch (opt.getSpeedupLevel()) {
+        case 0:
+            return llvm::CodeGenOpt::None;
+        case 1:
+            return llvm::CodeGenOpt::Less;
+        case 2:
+            return llvm::CodeGenOpt::Default;
+        default:
+            return llvm::CodeGenOpt::Aggressive;
+    }
+}
+
+/**
+ * Compile every function of the main module for CPUs with more features than the target, besides the default.
+ * The top-level code calls the functions through an ifunc, whose resolver picks the variant of the most capable
+ * features of the CPU the program is loaded on, as detected by __cpu_indicator_init of the GCC runtime.
+ * Variants call the variants of the same features directly, so they're still inlined and specialized.
+ *
+ * @param features Feature of each variant, e.g. avx2 or avx512f
+ */
+void Codegen::MultiversionFunctions(const std::vector<std::string> &features) {
+    if (!TargetMachine->getTargetTriple().isX86())
+        throw CodegenError({}, "Multiversioned functions are only supported on x86");
+
+    // Variants are checked from the most to the least capable CPUs, like GCC and Clang order target clones
+    std::vector<std::pair<std::string, unsigned>> variants;
+    for (const auto &feature: features) {
+        auto priority = llvm::StringSwitch<std::optional<unsigned>>(feature)
+#define X86_FEATURE_COMPAT(ENUM, STR, PRIORITY) .Case(STR, PRIORITY)
+#include <llvm/Support/X86TargetParser.def>
+                                .Default(std::nullopt);
+        if (!priority.has_value())
+            throw CodegenError({}, "Functions can't be multiversioned for feature {}", feature);
+
+        variants.emplace_back(feature, *priority);
+    }
+    std::stable_sort(variants.begin(), variants.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+
+    // CPU model and features detected by the GCC runtime, the features past the first 32 are in another variable
+    auto int32 = Builder->getInt32Ty();
+    auto cpu_model_type = StructType::get(int32, int32, int32, ArrayType::get(int32, 1));
+    auto cpu_model = llvm::cast<GlobalVariable>(TheModule->getOrInsertGlobal("__cpu_model", cpu_model_type));
+    auto cpu_features2 = llvm::cast<GlobalVariable>(TheModule->getOrInsertGlobal("__cpu_features2", int32));
+    auto cpu_init = TheModule->getOrInsertFunction("__cpu_indicator_init", FunctionType::get(Builder->getVoidTy(), false));
+    cpu_model->setDSOLocal(true);
+    cpu_features2->setDSOLocal(true);
+
+    std::vector<Function *> functions;
+    for (auto &function: *TheModule) {
+        if (!function.isDeclaration() && &function != TopLevelFunc)
+            functions.push_back(&function);
+    }
+    std::set<Function *> multiversioned(functions.begin(), functions.end());
+
+    // The top-level code and everything taking the address of a function goes through an ifunc, while the functions
+    // call each other directly, so every variant calls the variants of its own features, which it can inline
+    std::vector<std::string> names;
+    std::vector<Function *> resolvers;
+    std::vector<std::string> base_features;
+    for (auto function: functions) {
+        auto name = function->getName().str();
+        auto resolver = Function::Create(FunctionType::get(Builder->getPtrTy(), false), GlobalValue::InternalLinkage, name + ".resolver", *TheModule);
+        auto ifunc = GlobalIFunc::create(function->getValueType(), 0, function->getLinkage(), "", resolver, TheModule.get());
+        function->replaceUsesWithIf(ifunc, [&](Use &use) {
+            auto call = llvm::dyn_cast<CallBase>(use.getUser());
+            return call == nullptr || !call->isCallee(&use) || multiversioned.count(call->getFunction()) == 0;
+        });
+        function->setName(name + ".default");
+        function->setLinkage(GlobalValue::InternalLinkage);
+        ifunc->setName(name);
+
+        // A function without target features uses the features of the target machine
+        names.push_back(name);
+        resolvers.push_back(resolver);
+        base_features.push_back(function->hasFnAttribute("target-features") ? function->getFnAttribute("target-features").getValueAsString().str() : TargetMachine->getTargetFeatureString().str());
+    }
+
+    // The functions of a variant are cloned together, calls between them are mapped to the clones
+    std::vector<std::vector<Function *>> clones(variants.size());
+    for (size_t v = 0; v < variants.size(); v++) {
+        const auto &feature = variants[v].first;
+        ValueToValueMapTy values;
+        for (size_t i = 0; i < functions.size(); i++) {
+            auto clone = Function::Create(functions[i]->getFunctionType(), GlobalValue::InternalLinkage, functions[i]->getAddressSpace(), fmt::format("{}.{}", names[i], feature), TheModule.get());
+            values[functions[i]] = clone;
+            clones[v].push_back(clone);
+        }
+
+        for (size_t i = 0; i < functions.size(); i++) {
+            auto clone = clones[v][i];
+            for (auto [argument, cloned_argument]: llvm::zip(functions[i]->args(), clone->args())) {
+                cloned_argument.setName(argument.getName());
+                values[&argument] = &cloned_argument;
+            }
+
+            llvm::SmallVector<llvm::ReturnInst *, 8> returns;
+            llvm::CloneFunctionInto(clone, functions[i], values, llvm::CloneFunctionChangeType::LocalChangesOnly, returns);
+            clone->setLinkage(GlobalValue::InternalLinkage);
+            clone->addFnAttr("target-features", base_features[i].empty() ? "+" + feature : fmt::format("{},+{}", base_features[i], feature));
+        }
+    }
+
+    IRBuilder<> builder(*TheContext->getContext());
+    for (size_t i = 0; i < functions.size(); i++) {
+        auto resolver = resolvers[i];
+        builder.SetInsertPoint(BasicBlock::Create(*TheContext->getContext(), "entry", resolver));
+        builder.CreateCall(cpu_init);
+        auto features1 = builder.CreateLoad(int32, builder.CreateInBoundsGEP(cpu_model_type, cpu_model, {builder.getInt32(0), builder.getInt32(3), builder.getInt32(0)}));
+        auto features2 = builder.CreateLoad(int32, cpu_features2);
+
+        for (size_t v = 0; v < variants.size(); v++) {
+            const auto &feature = variants[v].first;
+            auto mask = llvm::X86::getCpuSupportsMask({feature});
+            llvm::Value *supported = builder.getTrue();
+            for (auto [detected, bits]: {std::pair(features1, mask & 0xffffffff), std::pair(features2, mask >> 32)}) {
+                if (bits != 0)
+                    supported = builder.CreateAnd(supported, builder.CreateICmpEQ(builder.CreateAnd(detected, bits), builder.getInt32(bits)));
+            }
+
+            auto selected = BasicBlock::Create(*TheContext->getContext(), feature, resolver);
+            auto next = BasicBlock::Create(*TheContext->getContext(), "next", resolver);
+            builder.CreateCondBr(supported, selected, next);
+            builder.SetInsertPoint(selected);
+            builder.CreateRet(clones[v][i]);
+            builder.SetInsertPoint(next);
+        }
+
+        builder.CreateRet(functions[i]);
     }
 }
 
 void Codegen::Optimize(OptimizationLevel opt) {
+    // With link time optimization, modules are only simplified before they're optimized together
+    auto lto = isJIT ? LTOKind::None : Graph->getLTO();
+    if (lto == LTOKind::Full)
+        Optimize(*TargetMachine, *TheModule, opt, ThinOrFullLTOPhase::FullLTOPreLink);
+    else if (lto == LTOKind::Thin)
+        Optimize(*TargetMachine, *TheModule, opt, ThinOrFullLTOPhase::ThinLTOPreLink);
+    else
+        Optimize(*TargetMachine, *TheModule, opt);
+}
+
+void Codegen::Optimize(llvm::TargetMachine &target_machine, Module &module, OptimizationLevel opt, ThinOrFullLTOPhase phase) {
     if (opt == OptimizationLevel::O0)
         return;
 
@@ -290,7 +513,7 @@ void Codegen::Optimize(OptimizationLevel opt) {
     llvm::CGSCCAnalysisManager CGAM;
     llvm::ModuleAnalysisManager MAM;
 
-    llvm::PassBuilder PB(&*TargetMachine);
+    llvm::PassBuilder PB(&target_machine);
 
     PB.registerModuleAnalyses(MAM);
     PB.registerCGSCCAnalyses(CGAM);
@@ -298,41 +521,380 @@ void Codegen::Optimize(OptimizationLevel opt) {
     PB.registerLoopAnalyses(LAM);
     PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
 
-    ModulePassManager MPM = PB.buildModuleOptimizationPipeline(opt, ThinOrFullLTOPhase::FullLTOPreLink);
+    ModulePassManager MPM;
+    switch (phase) {
+        case ThinOrFullLTOPhase::FullLTOPreLink:
+            MPM = PB.buildLTOPreLinkDefaultPipeline(opt);
+            break;
+        case ThinOrFullLTOPhase::ThinLTOPreLink:
+            MPM = PB.buildThinLTOPreLinkDefaultPipeline(opt);
+            break;
+        case ThinOrFullLTOPhase::FullLTOPostLink:
+            MPM = PB.buildLTODefaultPipeline(opt, nullptr);
+            break;
+        default:
+            MPM = PB.buildModuleOptimizationPipeline(opt, ThinOrFullLTOPhase::FullLTOPreLink);
+    }
 
-    MPM.run(*TheModule, MAM);
+    MPM.run(module, MAM);
 }
 
-void Codegen::WriteToObjectFile(const std::string &output) {
-    std::error_code err;
-    auto out = llvm::raw_fd_ostream(output + ".o", err);
+void Codegen::EmitObjectFile() {
+    llvm::SmallVector<char, 0> object;
+    llvm::raw_svector_ostream out(object);
+    WriteToObjectFile(*TargetMachine, *TheModule, out);
 
-    if (err) {
-        throw CodegenError({}, "Error opening file {} for writing: {}", output, err.message());
+    Graph->AddObject(std::move(object));
+}
+
+/**
+ * Split the module into partitions, which are optimized and compiled to in-memory objects in parallel.
+ * Functions are only inlined within their partition, trading some optimizations for compile time.
+ *
+ * @param partitions Number of partitions
+ * @param opt Optimization level of the partitions
+ */
+void Codegen::EmitObjectFiles(unsigned partitions, OptimizationLevel opt) {
+    // Partitions are moved to their own context through bitcode, a context can't be used by multiple threads
+    std::vector<llvm::SmallVector<char, 0>> bitcodes;
+    llvm::SplitModule(*TheModule, partitions, [&bitcodes](std::unique_ptr<Module> partition) {
+        llvm::raw_svector_ostream out(bitcodes.emplace_back());
+        llvm::WriteBitcodeToFile(*partition, out);
+    });
+
+    for (auto &object: EmitBitcodes(bitcodes, opt))
+        Graph->AddObject(std::move(object));
+}
+
+namespace {
+    /**
+     * Copies the globals a function or variable references into a unit of its own, as it's cloned into the unit.
+     * Private constants, such as strings, are copied with their initializer, everything else is declared.
+     */
+    class UnitMaterializer : public llvm::ValueMaterializer {
+    public:
+        UnitMaterializer(Module &unit, llvm::ValueToValueMapTy &map) : unit(unit), map(map) {}
+
+        llvm::Value *materialize(llvm::Value *value) override {
+            if (auto function = llvm::dyn_cast<Function>(value)) {
+                auto declaration = Function::Create(function->getFunctionType(), GlobalValue::ExternalLinkage, function->getAddressSpace(), function->getName(), &unit);
+                declaration->setAttributes(function->getAttributes());
+                declaration->setCallingConv(function->getCallingConv());
+                declaration->setVisibility(function->getVisibility());
+                return declaration;
+            }
+
+            auto variable = llvm::dyn_cast<GlobalVariable>(value);
+            if (variable == nullptr)
+                return nullptr;
+
+            bool copy = variable->isConstant() && variable->hasLocalLinkage() && variable->hasInitializer();
+            auto clone = new GlobalVariable(unit, variable->getValueType(), variable->isConstant(), copy ? variable->getLinkage() : GlobalValue::ExternalLinkage,
+                                            nullptr, variable->getName(), nullptr, variable->getThreadLocalMode(), variable->getAddressSpace());
+            clone->copyAttributesFrom(variable);
+            if (copy) {
+                // Mapped before the initializer, which may reference the constant itself
+                map[variable] = clone;
+                clone->setInitializer(llvm::MapValue(variable->getInitializer(), map, llvm::RF_None, nullptr, this));
+            }
+
+            return clone;
+        }
+
+    private:
+        Module &unit;
+        llvm::ValueToValueMapTy &map;
+    };
+}// namespace
+
+/**
+ * Compile every function to its own object, reusing the objects of the functions that didn't change since a
+ * previous build. A function is identified by its IR and the declarations of the functions it calls, so it's only
+ * compiled again when its body or the signature of a function it calls changes. Like with partitions, functions
+ * are only inlined into each other at link time, if ever. Global variables are defined together in one more object.
+ *
+ * @param opt Optimization level of the functions
+ */
+void Codegen::EmitObjectFilesIncrementally(OptimizationLevel opt) {
+    // Functions and variables are compiled separately, private ones must be visible to the objects of the others
+    auto externalize = [](GlobalValue &value) {
+        value.setName("lesma.local." + value.getName());
+        value.setLinkage(GlobalValue::ExternalLinkage);
+        value.setVisibility(GlobalValue::HiddenVisibility);
+    };
+    for (auto &F: *TheModule) {
+        if (!F.isDeclaration() && F.hasLocalLinkage())
+            externalize(F);
+    }
+    for (auto &variable: TheModule->globals()) {
+        if (!variable.isDeclaration() && !variable.isConstant() && variable.hasLocalLinkage())
+            externalize(variable);
     }
 
+    // Every unit only holds a function, or the variables, and the globals they reference
+    auto createUnit = [this](const std::string &name) {
+        auto unit = std::make_unique<Module>(name, TheModule->getContext());
+        unit->setSourceFileName(TheModule->getSourceFileName());
+        unit->setDataLayout(TheModule->getDataLayout());
+        unit->setTargetTriple(TheModule->getTargetTriple());
+        return unit;
+    };
+
+    std::vector<std::unique_ptr<Module>> units;
+    for (auto &F: *TheModule) {
+        if (F.isDeclaration())
+            continue;
+
+        auto unit = createUnit(F.getName().str());
+        llvm::ValueToValueMapTy map;
+        UnitMaterializer materializer(*unit, map);
+        auto clone = Function::Create(F.getFunctionType(), F.getLinkage(), F.getAddressSpace(), F.getName(), unit.get());
+        clone->copyAttributesFrom(&F);
+        map[&F] = clone;
+        for (auto [argument, cloned_argument]: llvm::zip(F.args(), clone->args())) {
+            cloned_argument.setName(argument.getName());
+            map[&argument] = &cloned_argument;
+        }
+
+        llvm::SmallVector<llvm::ReturnInst *, 8> returns;
+        llvm::CloneFunctionInto(clone, &F, map, llvm::CloneFunctionChangeType::DifferentModule, returns, "", nullptr, nullptr, &materializer);
+
+        // Cloning into another module lists the compile units of the function, even when it has none
+        auto compile_units = unit->getNamedMetadata("llvm.dbg.cu");
+        if (compile_units != nullptr && compile_units->getNumOperands() == 0)
+            unit->eraseNamedMetadata(compile_units);
+        units.push_back(std::move(unit));
+    }
+
+    auto variables = createUnit("variables");
+    llvm::ValueToValueMapTy map;
+    UnitMaterializer materializer(*variables, map);
+    std::vector<std::pair<GlobalVariable *, GlobalVariable *>> definitions;
+    for (auto &variable: TheModule->globals()) {
+        if (variable.isDeclaration() || (variable.isConstant() && variable.hasLocalLinkage()))
+            continue;
+
+        auto clone = llvm::cast<GlobalVariable>(llvm::MapValue(&variable, map, llvm::RF_None, nullptr, &materializer));
+        clone->setLinkage(variable.getLinkage());
+        definitions.emplace_back(&variable, clone);
+    }
+    for (auto [variable, clone]: definitions)
+        clone->setInitializer(llvm::MapValue(variable->getInitializer(), map, llvm::RF_None, nullptr, &materializer));
+    if (!definitions.empty())
+        units.push_back(std::move(variables));
+
+    ModuleCache cache(Graph->getCacheDirectory());
+    std::vector<std::string> keys;
+    std::vector<llvm::SmallVector<char, 0>> bitcodes;
+    for (auto &unit: units) {
+        llvm::SmallVector<char, 0> bitcode;
+        llvm::raw_svector_ostream out(bitcode);
+        llvm::WriteBitcodeToFile(*unit, out);
+
+        auto key = ModuleCache::getKey({bitcode.data(), bitcode.size()}, "", Graph->getTarget(), opt, LTOKind::None);
+        if (cache.HasObject(key)) {
+            Graph->AddObjectFile(cache.getObjectPath(key));
+        } else {
+            keys.push_back(key);
+            bitcodes.push_back(std::move(bitcode));
+        }
+    }
+
+    auto objects = EmitBitcodes(bitcodes, opt);
+    for (size_t i = 0; i < objects.size(); i++) {
+        // Fallback to linking the object from memory
+        if (cache.StoreObject(keys[i], {objects[i].data(), objects[i].size()}))
+            Graph->AddObjectFile(cache.getObjectPath(keys[i]));
+        else
+            Graph->AddObject(std::move(objects[i]));
+    }
+}
+
+/**
+ * Optimize and compile modules to in-memory objects in parallel, each in its own context
+ *
+ * @param bitcodes Bitcode of the modules
+ * @param opt Optimization level of the modules
+ * @return Object of each module
+ */
+std::vector<llvm::SmallVector<char, 0>> Codegen::EmitBitcodes(const std::vector<llvm::SmallVector<char, 0>> &bitcodes, OptimizationLevel opt) {
+    std::vector<llvm::SmallVector<char, 0>> objects(bitcodes.size());
+    std::mutex mutex;
+    std::optional<std::string> error;
+    bool trace = llvm::timeTraceProfilerEnabled();
+    llvm::ThreadPool pool(llvm::hardware_concurrency(Graph->getThreads()));
+    for (size_t i = 0; i < bitcodes.size(); i++) {
+        pool.async([&, i] {
+            TimeTraceThread trace_thread(trace);
+            try {
+                llvm::TimeTraceScope scope("Emit", [&] { return fmt::format("module{}", i); });
+                llvm::LLVMContext context;
+                auto buffer = llvm::MemoryBufferRef(llvm::StringRef(bitcodes[i].data(), bitcodes[i].size()), fmt::format("module{}", i));
+                auto module = llvm::parseBitcodeFile(buffer, context);
+                if (!module)
+                    throw CodegenError({}, "Unable to read module {}: {}", i, toString(module.takeError()));
+
+                auto target_machine = InitializeTargetMachine(*Graph);
+                Optimize(*target_machine, **module, opt);
+
+                llvm::raw_svector_ostream out(objects[i]);
+                WriteToObjectFile(*target_machine, **module, out);
+            } catch (const LesmaError &err) {
+                std::lock_guard<std::mutex> lock(mutex);
+                error = err.what();
+            }
+        });
+    }
+    pool.wait();
+
+    if (error.has_value())
+        throw CodegenError({}, "{}", *error);
+
+    return objects;
+}
+
+/**
+ * Link the imported modules into the main module, and optimize the whole program at once.
+ * Only the entry point is visible outside the program, so everything else can be inlined across modules or removed.
+ *
+ * @param opt Optimization level of the program
+ */
+void Codegen::LinkModules(OptimizationLevel opt) {
+    llvm::Linker linker(*TheModule);
+    for (auto &import: Graph->TakeModules()) {
+        // Imports are compiled in their own context, they're moved to the one of the main module through bitcode
+        std::string name;
+        llvm::SmallVector<char, 0> bitcode;
+        import.withModuleDo([&name, &bitcode](Module &module) {
+            name = module.getModuleIdentifier();
+            llvm::raw_svector_ostream out(bitcode);
+            llvm::WriteBitcodeToFile(module, out);
+        });
+
+        auto module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()), name), *TheContext->getContext());
+        if (!module)
+            throw CodegenError({}, "Unable to read {}: {}", name, toString(module.takeError()));
+
+        if (linker.linkInModule(std::move(*module)))
+            throw CodegenError({}, "Unable to link {}", name);
+    }
+
+    auto main_name = TopLevelFunc->getName().str();
+    llvm::internalizeModule(*TheModule, [&main_name](const GlobalValue &value) { return value.getName() == main_name; });
+
+    Optimize(*TargetMachine, *TheModule, opt, ThinOrFullLTOPhase::FullLTOPostLink);
+}
+
+/**
+ * Optimize the main and imported modules with ThinLTO, which imports functions across modules based on their summaries,
+ * and compile them to in-memory objects in parallel.
+ *
+ * @param opt Optimization level of the program
+ */
+void Codegen::EmitObjectFilesWithThinLTO(OptimizationLevel opt) {
+    lto::Config config;
+    config.CPU = Graph->getCPU();
+    config.MAttrs = llvm::SubtargetFeatures(Graph->getFeatures()).getFeatures();
+    config.RelocModel = TargetMachine->getRelocationModel();
+    config.CGOptLevel = Graph->getCodeGenOptLevel();
+    config.OptLevel = opt.getSpeedupLevel();
+    config.TimeTraceEnabled = llvm::timeTraceProfilerEnabled();
+    config.TimeTraceGranularity = TimeTrace::getGranularity();
+
+    lto::LTO lto(std::move(config), lto::createInProcessThinBackend(llvm::heavyweight_hardware_concurrency(Graph->getThreads())));
+
+    // The main module is added first, its entry point is the only definition visible outside the program
+    auto main_name = TopLevelFunc->getName().str();
+    std::vector<std::pair<std::string, llvm::SmallVector<char, 0>>> bitcodes;
+    auto writeBitcode = [&bitcodes](Module &module) {
+        auto &[name, bitcode] = bitcodes.emplace_back(module.getModuleIdentifier(), llvm::SmallVector<char, 0>());
+        llvm::raw_svector_ostream out(bitcode);
+        WriteToBitcodeWithSummary(module, out);
+    };
+
+    TheModule->setModuleIdentifier(filename);
+    writeBitcode(*TheModule);
+    for (auto &import: Graph->TakeModules())
+        import.withModuleDo(writeBitcode);
+
+    // The inputs refer to the bitcode, which is kept until the objects are emitted
+    llvm::StringSet<> defined;
+    for (auto &[name, bitcode]: bitcodes) {
+        auto input = lto::InputFile::create(llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()), name));
+        if (!input)
+            throw CodegenError({}, "Unable to read {}: {}", name, toString(input.takeError()));
+
+        std::vector<lto::SymbolResolution> resolutions;
+        for (const auto &symbol: (*input)->symbols()) {
+            auto &resolution = resolutions.emplace_back();
+            if (symbol.isUndefined())
+                continue;
+
+            resolution.Prevailing = defined.insert(symbol.getName()).second;
+            resolution.FinalDefinitionInLinkageUnit = true;
+            resolution.VisibleToRegularObj = symbol.getName() == main_name;
+        }
+
+        if (auto err = lto.add(std::move(*input), resolutions))
+            throw CodegenError({}, "Unable to add {} to ThinLTO: {}", name, toString(std::move(err)));
+    }
+
+    std::vector<llvm::SmallVector<char, 0>> objects(lto.getMaxTasks());
+    auto addStream = [&objects](unsigned task) -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+        return std::make_unique<llvm::CachedFileStream>(std::make_unique<llvm::raw_svector_ostream>(objects[task]));
+    };
+
+    if (auto err = lto.run(addStream))
+        throw CodegenError({}, "ThinLTO failed: {}", toString(std::move(err)));
+
+    for (auto &object: objects) {
+        if (!object.empty())
+            Graph->AddObject(std::move(object));
+    }
+}
+
+void Codegen::WriteToBitcodeWithSummary(Module &module, llvm::raw_ostream &out) {
+    llvm::ProfileSummaryInfo profile_summary(module);
+    auto index = llvm::buildModuleSummaryIndex(module, nullptr, &profile_summary);
+    llvm::WriteBitcodeToFile(module, out, false, &index);
+}
+
+void Codegen::WriteToObjectFile(llvm::TargetMachine &target_machine, Module &module, llvm::raw_pwrite_stream &out) {
     llvm::legacy::PassManager passManager;
-    if (TargetMachine->addPassesToEmitFile(passManager, out, nullptr, llvm::CGFT_ObjectFile))
+    if (target_machine.addPassesToEmitFile(passManager, out, nullptr, llvm::CGFT_ObjectFile))
         throw CodegenError({}, "Target Machine can't emit an object file");
     // Emit object file
-    passManager.run(*TheModule);
-
-    // Flush and close the file
-    out.flush();
-    out.close();
+    passManager.run(module);
 }
 
-[[maybe_unused]] void Codegen::LinkObjectFileWithLLD(const std::string &obj_filename) {
-    std::string output = getBasename(obj_filename);
+void Codegen::LinkObjectFilesWithLLD(const std::string &output, const LinkerConfig &config) {
+    LinkerInputs inputs(Graph->getObjects(), Graph->getObjectFiles(), true);
 
     llvm::SmallVector<const char *, 32> args;
-    args.push_back("lld");
+    args.push_back("ld.lld");
     args.push_back("-o");
     args.push_back(output.c_str());
-    args.push_back(obj_filename.c_str());
-    for (const auto &obj: ObjectFiles) {
+#if !defined(__APPLE__) && !defined(_WIN32)
+    // Add the C runtime and its libraries for ELF
+    args.push_back("--eh-frame-hdr");
+    args.push_back("-dynamic-linker");
+    args.push_back(config.dynamic_linker.c_str());
+    for (const auto &obj: config.start_files)
+        args.push_back(obj.c_str());
+    for (const auto &path: config.library_paths) {
+        args.push_back("-L");
+        args.push_back(path.c_str());
+    }
+#endif
+    for (const auto &obj: inputs.getPaths()) {
         args.push_back(obj.c_str());
     }
+#if !defined(__APPLE__) && !defined(_WIN32)
+    for (const auto &lib: config.libraries)
+        args.push_back(lib.c_str());
+    for (const auto &obj: config.end_files)
+        args.push_back(obj.c_str());
+#endif
     // Add the standard library path for Apple
 #ifdef __APPLE__
     args.push_back("-arch");
@@ -346,37 +908,37 @@ void Codegen::WriteToObjectFile(const std::string &output) {
     args.push_back("-lSystem");
 #endif
 
-    // Run the LLD linker
+    // Run the LLD linker, which isn't reentrant
+    static std::mutex lld_mutex;
+    std::lock_guard<std::mutex> lock(lld_mutex);
+
     bool success = false;
 #ifdef __APPLE__
-    success = lld::macho::link(args, llvm::outs(), llvm::errs(), false, true);
+    success = lld::macho::link(args, llvm::outs(), llvm::errs(), false, false);
 #elif defined(_WIN32)
-    success = lld::coff::link(args, llvm::outs(), llvm::errs(), false, true);
+    success = lld::coff::link(args, llvm::outs(), llvm::errs(), false, false);
 #else
-    success = lld::elf::link(args, llvm::outs(), llvm::errs(), false, true);
+    success = lld::elf::link(args, llvm::outs(), llvm::errs(), false, false);
 #endif
+    // LLD keeps the state of a link until it's destroyed, even when it failed, and the next link requires a new one
+    lld::CommonLinkerContext::destroy();
     if (!success)
         throw CodegenError({}, "Linking Failed");
-
-    // Remove object files
-    llvm::sys::fs::remove(obj_filename);
-    for (const auto &obj: ObjectFiles)
-        llvm::sys::fs::remove(obj);
 }
 
-[[maybe_unused]] void Codegen::LinkObjectFileWithClang(const std::string &obj_filename) {
+void Codegen::LinkObjectFilesWithClang(const std::string &output) {
     auto clangPath = llvm::sys::findProgramByName("clang");
     if (clangPath.getError())
         throw CodegenError({}, "Unable to find clang path");
 
-    std::string output = getBasename(obj_filename);
+    // The linker runs in another process, in-memory objects are written to temporary files
+    LinkerInputs inputs(Graph->getObjects(), Graph->getObjectFiles(), false);
 
     llvm::SmallVector<const char *, 32> args;
     args.push_back(clangPath.get().c_str());
     args.push_back("-o");
     args.push_back(output.c_str());
-    args.push_back(obj_filename.c_str());
-    for (const auto &obj: ObjectFiles) {
+    for (const auto &obj: inputs.getPaths()) {
         args.push_back(obj.c_str());
     }
 
@@ -408,24 +970,44 @@ void Codegen::WriteToObjectFile(const std::string &output) {
     if (Res != 0) {
         throw CodegenError({}, "Linking failed");
     }
-
-    // Remove object files
-    llvm::sys::fs::remove(obj_filename);
-    for (const auto &obj: ObjectFiles)
-        llvm::sys::fs::remove(obj);
 }
 
-void Codegen::LinkObjectFile(const std::string &obj_filename) {
-    LinkObjectFileWithClang(obj_filename);
+void Codegen::LinkObjectFiles(const std::string &output) {
+#if defined(__APPLE__) || defined(_WIN32)
+    LinkObjectFilesWithClang(output);
+#else
+    // Link in-process with LLD, unless the C runtime couldn't be found
+    if (auto config = LinkerConfig::Get(TargetMachine->getTargetTriple(), Graph->getCacheDirectory()))
+        LinkObjectFilesWithLLD(output, *config);
+    else
+        LinkObjectFilesWithClang(output);
+#endif
 }
 
-void Codegen::PrepareJIT() {
-    auto jit_error = TheJIT->addIRModule(ThreadSafeModule(std::move(TheModule), *TheContext));
+void Codegen::PrepareJIT(bool lazy) {
+    // Imported modules are added to the JIT of the main module
+    TheJIT = InitializeJIT(lazy);
+
+    auto addModule = [this, lazy](ThreadSafeModule module) {
+        if (lazy)
+            return static_cast<LLLazyJIT &>(*TheJIT).addLazyIRModule(std::move(module));
+
+        return TheJIT->addIRModule(std::move(module));
+    };
+
+    for (auto &module: Graph->TakeModules()) {
+        if (auto err = addModule(std::move(module)))
+            throw CodegenError({}, "Failed adding import to JIT:\n{}", toString(std::move(err)));
+    }
+
+    // The module is owned by the JIT afterwards
+    auto main_name = TopLevelFunc->getName().str();
+    auto jit_error = addModule(ThreadSafeModule(std::move(TheModule), *TheContext));
     if (jit_error)
-        throw CodegenError({}, "JIT Error:\n{}");
-    auto main_func = TheJIT->lookup(TopLevelFunc->getName());
+        throw CodegenError({}, "JIT Error:\n{}", toString(std::move(jit_error)));
+    auto main_func = TheJIT->lookup(main_name);
     if (!main_func)
-        throw CodegenError({}, "Couldn't find top level function\n");
+        throw CodegenError({}, "Couldn't find top level function:\n{}", toString(main_func.takeError()));
     mainFuncAddress = jitTargetAddressToFunction<MainFnTy *>(main_func->getValue());
 }
 
@@ -437,6 +1019,125 @@ int Codegen::ExecuteJIT() {
     return mainFuncAddress();
 }
 
+/**
+ * Prepare the JIT of the REPL, which every input is added to. The first module only declares the standard library.
+ */
+void Codegen::PrepareREPL() {
+    isREPL = true;
+    TheJIT = InitializeJIT(false);
+
+    for (auto &module: Graph->TakeModules()) {
+        if (auto err = TheJIT->addIRModule(std::move(module)))
+            throw CodegenError({}, "Failed adding import to JIT:\n{}", toString(std::move(err)));
+    }
+
+    for (auto &[name, symbol]: Scope->getSymbols()) {
+        if (auto global = llvm::dyn_cast_or_null<GlobalValue>(symbol->getLLVMValue()))
+            REPLDeclarations[symbol] = {global->getName().str(), global->getValueType()};
+    }
+
+    Builder->CreateRet(ConstantInt::getSigned(Builder->getInt64Ty(), 0));
+    JITCache->Exclude(TheModule.get());
+    if (auto err = TheJIT->addIRModule(ThreadSafeModule(std::move(TheModule), *TheContext)))
+        throw CodegenError({}, "JIT Error:\n{}", toString(std::move(err)));
+}
+
+/**
+ * Compile an input of the REPL to its own module with its own top-level function, add it to the JIT and run it.
+ * The symbols of the previous inputs are declared in the module, they're never compiled again.
+ * If the input fails to compile or to be added to the JIT, the symbols it defined are forgotten.
+ *
+ * @param parser Parsed input
+ * @param srcMgr Source of the input
+ * @return Result of the top-level function
+ */
+int Codegen::Evaluate(std::shared_ptr<Parser> parser, std::shared_ptr<SourceMgr> srcMgr) {
+    Parser_ = std::move(parser);
+    SourceManager = std::move(srcMgr);
+    Prototypes.clear();
+
+    TheModule = InitializeModule();
+    TopLevelFunc = InitializeTopLevel();
+    TopLevelFunc->setName(fmt::format("input.{}", ++REPLInputs));
+
+    for (auto &[symbol, declaration]: REPLDeclarations) {
+        auto &[name, type] = declaration;
+        if (auto function_type = llvm::dyn_cast<FunctionType>(type))
+            symbol->setLLVMValue(TheModule->getOrInsertFunction(name, function_type).getCallee());
+        else
+            symbol->setLLVMValue(TheModule->getOrInsertGlobal(name, type));
+    }
+
+    // The input is removed from the JIT if it fails, so its symbols can be defined again by the next inputs.
+    // Its imports stay in the JIT, they're compiled once per session.
+    auto tracker = TheJIT->getMainJITDylib().createResourceTracker();
+    auto symbols = Scope->getSymbols();
+    auto types = Scope->getTypes();
+    try {
+        Run();
+        Optimize(Graph->getOptimizationLevel());
+
+        std::map<lesma::Value *, std::pair<std::string, llvm::Type *>> declarations;
+        for (auto &[name, symbol]: Scope->getSymbols()) {
+            auto global = llvm::dyn_cast_or_null<GlobalValue>(symbol->getLLVMValue());
+            if (global != nullptr && global->getParent() == TheModule.get())
+                declarations[symbol] = {global->getName().str(), global->getValueType()};
+        }
+
+        for (auto &module: Graph->TakeModules()) {
+            if (auto err = TheJIT->addIRModule(std::move(module)))
+                throw CodegenError({}, "Failed adding import to JIT:\n{}", toString(std::move(err)));
+        }
+
+        // Inputs are rarely evaluated twice, caching them would only grow the cache
+        auto input_name = TopLevelFunc->getName().str();
+        JITCache->Exclude(TheModule.get());
+        if (auto err = TheJIT->addIRModule(tracker, ThreadSafeModule(std::move(TheModule), *TheContext)))
+            throw CodegenError({}, "{}", toString(std::move(err)));
+
+        auto input_func = TheJIT->lookup(input_name);
+        if (!input_func)
+            throw CodegenError({}, "Couldn't find top level function of the input:\n{}", toString(input_func.takeError()));
+
+        declarations.merge(REPLDeclarations);
+        REPLDeclarations = std::move(declarations);
+
+        return jitTargetAddressToFunction<MainFnTy *>(input_func->getValue())();
+    } catch (const LesmaError &) {
+        if (auto err = tracker->remove())
+            consumeError(std::move(err));
+        Scope->setSymbols(std::move(symbols));
+        Scope->setTypes(std::move(types));
+        breakBlocks = {};
+        continueBlocks = {};
+        deferStack = {};
+        isBreak = false;
+        isReturn = false;
+        isAssignment = false;
+        throw;
+    }
+}
+
+/**
+ * Get the address of a function defined or imported by an input of the REPL
+ *
+ * @param name Name of the function
+ * @return Address of the function, or nullptr if there's no such function
+ */
+void *Codegen::LookupFunction(const std::string &name) {
+    auto symbol = Scope->lookup(name);
+    if (TheJIT == nullptr || symbol == nullptr || !symbol->getType()->is(TY_FUNCTION))
+        return nullptr;
+
+    auto address = TheJIT->lookup(symbol->getMangledName());
+    if (!address) {
+        consumeError(address.takeError());
+        return nullptr;
+    }
+
+    return jitTargetAddressToPointer<void *>(address->getValue());
+}
+
 void Codegen::Run() {
     deferStack.emplace();
     Parser_->getAST()->accept(*this);
@@ -454,6 +1155,9 @@ void Codegen::Run() {
 
     // Return 0 for top-level function
     Builder->CreateRet(ConstantInt::getSigned(Builder->getInt64Ty(), 0));
+
+    if (MemoryReport::isEnabled())
+        MemoryReport::AddModule(*TheModule);
 }
 
 void Codegen::Dump() {
@@ -540,7 +1244,14 @@ void Codegen::visit(const VarDecl *node) {
         type = result->getType();
     }
 
-    auto ptr = Builder->CreateAlloca(type->getLLVMType(), nullptr, node->getIdentifier()->getValue());
+    llvm::Value *ptr;
+    if (isREPL && Builder->GetInsertBlock()->getParent() == TopLevelFunc) {
+        // Top-level variables of the REPL outlive their input, so they're globals used by the next inputs
+        auto name = fmt::format("{}.{}", node->getIdentifier()->getValue(), TopLevelFunc->getName().str());
+        ptr = new GlobalVariable(*TheModule, type->getLLVMType(), false, GlobalValue::ExternalLinkage, Constant::getNullValue(type->getLLVMType()), name);
+    } else {
+        ptr = Builder->CreateAlloca(type->getLLVMType(), nullptr, node->getIdentifier()->getValue());
+    }
 
     if (type->is(TY_CLASS)) {
         type = new Type(TY_PTR, Builder->getPtrTy(), type);
@@ -692,7 +1403,8 @@ void Codegen::visit(const FuncDecl *node) {
     }
 
     auto mangledName = getMangledName(node->getSpan(), node->getName(), paramTypes, selfSymbol != nullptr);
-    auto linkage = shouldExport ? Function::ExternalLinkage : Function::PrivateLinkage;
+    // Functions defined in the REPL are called by the next inputs
+    auto linkage = shouldExport || isREPL ? Function::ExternalLinkage : Function::PrivateLinkage;
 
     node->getReturnType()->accept(*this);
 
@@ -1,7 +1,14 @@
 #pragma once
 
 #include "liblesma/AST/ASTVisitor.h"
+#include "liblesma/Backend/JITObjectCache.h"
+#include "liblesma/Backend/LinkerConfig.h"
+#include "liblesma/Backend/LinkerInputs.h"
+#include "liblesma/Backend/ModuleCache.h"
+#include "liblesma/Backend/ModuleGraph.h"
+#include "liblesma/Common/TimeTrace.h"
 #include "liblesma/Frontend/Parser.h"
+#include "liblesma/Symbol/ModuleInterface.h"
 #include "liblesma/Symbol/SymbolTable.h"
 #include <clang/Basic/Diagnostic.h>
 #include <clang/Basic/DiagnosticIDs.h>
@@ -16,26 +23,46 @@
 #include <clang/Driver/Job.h>
 #include <clang/Frontend/TextDiagnosticPrinter.h>
 #include <filesystem>
+#include <lld/Common/CommonLinkerContext.h>
 #include <lld/Common/Driver.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/ADT/StringSwitch.h>
 #include <llvm/Analysis/CGSCCPassManager.h>
 #include <llvm/Analysis/LoopAnalysisManager.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/PassManager.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/LTO/LTO.h>
 #include <llvm/Linker/Linker.h>
+#include <llvm/MC/SubtargetFeature.h>
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Host.h>
 #include <llvm/Support/Program.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/Caching.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/TimeProfiler.h>
 #include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/X86TargetParser.h>
+#include <llvm/Transforms/IPO/Internalize.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <map>
+#include <mutex>
 #include <regex>
+#include <set>
 #include <utility>
 
 using namespace llvm;
@@ -54,6 +81,8 @@ namespace lesma {
         std::unique_ptr<Module> TheModule;
         std::unique_ptr<IRBuilder<>> Builder;
 
+        // The object cache is used by the JIT, so it's destroyed after it
+        std::unique_ptr<JITObjectCache> JITCache;
         std::unique_ptr<LLJIT> TheJIT;
         std::unique_ptr<llvm::TargetMachine> TargetMachine;
         std::shared_ptr<Parser> Parser_;
@@ -67,9 +96,12 @@ namespace lesma {
         std::stack<llvm::BasicBlock *> continueBlocks;
         std::stack<std::vector<Statement *>> deferStack;
 
-        std::vector<std::string> ObjectFiles;
-        std::vector<std::string> ImportedModules;
+        std::shared_ptr<ModuleGraph> Graph;
+        std::vector<ModuleDependency> Dependencies;
         std::vector<std::tuple<lesma::Value *, const FuncDecl *, Value *>> Prototypes;
+        // Symbols defined or imported by previous inputs of the REPL, with their names and types in the JIT
+        std::map<lesma::Value *, std::pair<std::string, llvm::Type *>> REPLDeclarations;
+        unsigned REPLInputs = 0;
         llvm::Function *TopLevelFunc;
         MainFnTy *mainFuncAddress = nullptr;
         Value *selfSymbol = nullptr;
@@ -78,9 +110,10 @@ namespace lesma {
         bool isAssignment = false;
         bool isJIT = false;
         bool isMain = true;
+        bool isREPL = false;
 
     public:
-        Codegen(std::shared_ptr<Parser> parser, std::shared_ptr<SourceMgr> srcMgr, const std::string &filename, std::vector<std::string> imports, bool jit, bool main, std::string alias = "", const std::shared_ptr<ThreadSafeContext> & = nullptr);
+        Codegen(std::shared_ptr<Parser> parser, std::shared_ptr<SourceMgr> srcMgr, const std::string &filename, std::shared_ptr<ModuleGraph> graph, bool jit, bool main, std::string alias = "", const std::shared_ptr<ThreadSafeContext> & = nullptr);
         ~Codegen() override {
             delete selfSymbol;
             delete Scope;
@@ -88,22 +121,40 @@ namespace lesma {
 
         void Dump();
         void Run();
-        void PrepareJIT();
+        void PrepareJIT(bool lazy = false);
         int ExecuteJIT();
-        void WriteToObjectFile(const std::string &output);
-        void LinkObjectFile(const std::string &obj_filename);
+        void PrepareREPL();
+        int Evaluate(std::shared_ptr<Parser> parser, std::shared_ptr<SourceMgr> srcMgr);
+        void *LookupFunction(const std::string &name);
+        void EmitObjectFile();
+        void EmitObjectFiles(unsigned partitions, OptimizationLevel opt);
+        void EmitObjectFilesWithThinLTO(OptimizationLevel opt);
+        void EmitObjectFilesIncrementally(OptimizationLevel opt);
+        void LinkModules(OptimizationLevel opt);
+        void LinkObjectFiles(const std::string &output);
         void Optimize(OptimizationLevel opt);
+        void MultiversionFunctions(const std::vector<std::string> &features);
+
+        static void InitializeTargets();
+        static void CompileNode(const std::shared_ptr<ModuleGraph> &graph, ModuleNode &node, bool jit);
+        static llvm::CodeGenOpt::Level getCodeGenOptLevel(OptimizationLevel opt);
+        static std::string getHostCPUFeatures();
 
     protected:
-        std::unique_ptr<llvm::TargetMachine> InitializeTargetMachine();
+        static std::unique_ptr<llvm::TargetMachine> InitializeTargetMachine(const ModuleGraph &graph);
         std::unique_ptr<Module> InitializeModule();
-        std::unique_ptr<LLJIT> InitializeJIT();
+        std::unique_ptr<LLJIT> InitializeJIT(bool lazy);
         llvm::Function *InitializeTopLevel();
 
-        [[maybe_unused]] void LinkObjectFileWithClang(const std::string &obj_filename);
-        [[maybe_unused]] void LinkObjectFileWithLLD(const std::string &obj_filename);
+        void LinkObjectFilesWithClang(const std::string &output);
+        void LinkObjectFilesWithLLD(const std::string &output, const LinkerConfig &config);
 
         void CompileModule(llvm::SMRange span, const std::string &filepath, bool isStd, const std::string &alias, bool importAll, bool importToScope, const std::vector<std::pair<std::string, std::string>> &imported_names);
+        void ImportInterface(const ModuleInterface &interface, const std::string &alias, bool importAll, bool importToScope, const std::vector<std::pair<std::string, std::string>> &imported_names);
+        static void WriteToObjectFile(llvm::TargetMachine &target_machine, Module &module, llvm::raw_pwrite_stream &out);
+        std::vector<llvm::SmallVector<char, 0>> EmitBitcodes(const std::vector<llvm::SmallVector<char, 0>> &bitcodes, OptimizationLevel opt);
+        static void WriteToBitcodeWithSummary(Module &module, llvm::raw_ostream &out);
+        static void Optimize(llvm::TargetMachine &target_machine, Module &module, OptimizationLevel opt, ThinOrFullLTOPhase phase = ThinOrFullLTOPhase::None);
 
         void visit(const Statement *node) override;
         void visit(const Compound *node) override;
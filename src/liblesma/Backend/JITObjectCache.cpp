@@ -0,0 +1,75 @@
+#include "JITObjectCache.h"
+
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "liblesma/Common/LesmaVersion.h"
+
+using namespace lesma;
+
+void JITObjectCache::notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) {
+    std::string key;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = Keys.find(module);
+        if (it == Keys.end())
+            return;
+
+        key = std::move(it->second);
+        Keys.erase(it);
+    }
+
+    // Failures are ignored, the object is compiled again next time
+    Cache.StoreObject(key, object.getBuffer());
+}
+
+std::unique_ptr<llvm::MemoryBuffer> JITObjectCache::getObject(const llvm::Module *module) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (Excluded.erase(module))
+            return nullptr;
+    }
+
+    auto key = getKey(*module);
+    if (auto buffer = Cache.LoadObject(key))
+        return buffer;
+
+    // Remember the key, to store the object once it's compiled
+    std::lock_guard<std::mutex> lock(mutex);
+    Keys[module] = key;
+    return nullptr;
+}
+
+/**
+ * Exclude a module from the cache, its object is neither looked up nor stored
+ *
+ * @param module Module about to be added to the JIT
+ */
+void JITObjectCache::Exclude(const llvm::Module *module) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Excluded.insert(module);
+}
+
+/**
+ * Compute the cache key of a module about to be compiled by the JIT
+ *
+ * @param module Module to compile
+ * @return Hex digest of the compiler version, the target and the module bitcode
+ */
+std::string JITObjectCache::getKey(const llvm::Module &module) const {
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream out(bitcode);
+    llvm::WriteBitcodeToFile(module, out);
+
+    llvm::MD5 hash;
+    for (auto part: {llvm::StringRef(LESMA_VERSION), llvm::StringRef(target), llvm::StringRef(bitcode.data(), bitcode.size())}) {
+        hash.update(part);
+        hash.update(llvm::ArrayRef<uint8_t>{0});
+    }
+
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+
+    return result.digest().str().str();
+}
\ No newline at end of file
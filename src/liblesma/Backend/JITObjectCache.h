@@ -0,0 +1,38 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "liblesma/Backend/ModuleCache.h"
+#include "liblesma/Common/Utils.h"
+
+namespace lesma {
+    /**
+     * Object cache of the JIT, which stores the machine code of every module it compiles on disk.
+     * Objects are keyed by a hash of the module bitcode and the target, so unchanged modules are only loaded.
+     * Modules which are unlikely to be compiled again, like the inputs of the REPL, can be excluded from the cache.
+     */
+    class JITObjectCache : public llvm::ObjectCache {
+    public:
+        explicit JITObjectCache(std::string target, std::string directory = getCacheDir() + "jit") : target(std::move(target)), Cache(std::move(directory)) {}
+
+        void notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) override;
+        std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *module) override;
+        void Exclude(const llvm::Module *module);
+
+    private:
+        std::string target;
+        ModuleCache Cache;
+
+        // Keys of the modules being compiled, which are computed when the JIT looks them up
+        std::mutex mutex;
+        std::map<const llvm::Module *, std::string> Keys;
+        std::set<const llvm::Module *> Excluded;
+
+        [[nodiscard]] std::string getKey(const llvm::Module &module) const;
+    };
+}// namespace lesma
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "LinkerConfig.h"
+
+#include <algorithm>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+
+#include "liblesma/Backend/ModuleCache.h"
+#include "liblesma/Common/Utils.h"
+
+using namespace lesma;
+
+static std::vector<std::string> toStrings(const llvm::json::Array *array) {
+    std::vector<std::string> strings;
+    if (array == nullptr)
+        return strings;
+
+    for (const auto &value: *array) {
+        if (auto str = value.getAsString())
+            strings.push_back(str->str());
+    }
+
+    return strings;
+}
+
+/**
+ * Get the linker configuration of a target, from the cache or by discovering it
+ *
+ * @param triple Target triple of the linked objects
+ * @param directory Directory of the cached configurations
+ * @return Configuration, or nothing if the C runtime couldn't be found
+ */
+std::optional<LinkerConfig> LinkerConfig::Get(const llvm::Triple &triple, const std::string &directory) {
+    auto path = fmt::format("{}/linker-{}.json", directory, triple.str());
+
+    // Cached files may have been removed by a system upgrade
+    auto config = Load(path);
+    if (config.has_value() && config->Exists())
+        return config;
+
+    config = Discover(triple);
+    if (config.has_value())
+        config->Store(path);
+
+    return config;
+}
+
+/**
+ * Find the C runtime objects, the dynamic linker and the libraries in the usual locations of the target
+ *
+ * @param triple Target triple of the linked objects
+ * @return Configuration, or nothing if the C runtime couldn't be found
+ */
+std::optional<LinkerConfig> LinkerConfig::Discover(const llvm::Triple &triple) {
+    if (!triple.isOSBinFormatELF())
+        return std::nullopt;
+
+    LinkerConfig config;
+    auto multiarch = fmt::format("{}-linux-gnu", triple.getArchName().str());
+
+    // Directories containing the C runtime objects and libc
+    for (const std::string dir: {"/usr/lib/" + multiarch, "/lib/" + multiarch, std::string("/usr/lib64"), std::string("/lib64"), std::string("/usr/lib"), std::string("/lib")}) {
+        if (llvm::sys::fs::is_directory(dir))
+            config.library_paths.push_back(dir);
+    }
+
+    auto crt_dir = std::find_if(config.library_paths.begin(), config.library_paths.end(), [](const std::string &dir) {
+        return llvm::sys::fs::exists(dir + "/crt1.o");
+    });
+    if (crt_dir == config.library_paths.end())
+        return std::nullopt;
+
+    config.start_files = {*crt_dir + "/crt1.o", *crt_dir + "/crti.o"};
+    config.end_files = {*crt_dir + "/crtn.o"};
+    config.libraries = {"-lc", "-lm"};
+
+    // GCC runtime, with the newest version installed
+    std::string gcc_dir;
+    for (const auto &gcc_root: {"/usr/lib/gcc/" + multiarch, "/usr/lib/gcc/" + triple.str()}) {
+        std::error_code ec;
+        for (llvm::sys::fs::directory_iterator it(gcc_root, ec), end; it != end && !ec; it.increment(ec)) {
+            if (llvm::sys::fs::exists(it->path() + "/crtbegin.o") && (gcc_dir.empty() || llvm::StringRef(it->path()).compare_numeric(gcc_dir) > 0))
+                gcc_dir = it->path();
+        }
+    }
+
+    if (!gcc_dir.empty()) {
+        config.start_files.push_back(gcc_dir + "/crtbegin.o");
+        config.end_files.insert(config.end_files.begin(), gcc_dir + "/crtend.o");
+        config.library_paths.insert(config.library_paths.begin(), gcc_dir);
+        config.libraries.emplace_back("-lgcc");
+    }
+
+    // Dynamic linker of glibc
+    switch (triple.getArch()) {
+        case llvm::Triple::x86_64:
+            config.dynamic_linker = "/lib64/ld-linux-x86-64.so.2";
+            break;
+        case llvm::Triple::aarch64:
+            config.dynamic_linker = "/lib/ld-linux-aarch64.so.1";
+            break;
+        case llvm::Triple::x86:
+            config.dynamic_linker = "/lib/ld-linux.so.2";
+            break;
+        default:
+            return std::nullopt;
+    }
+
+    if (!llvm::sys::fs::exists(config.dynamic_linker))
+        return std::nullopt;
+
+    return config;
+}
+
+std::optional<LinkerConfig> LinkerConfig::Load(const std::string &path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer)
+        return std::nullopt;
+
+    auto json = llvm::json::parse((*buffer)->getBuffer());
+    if (!json) {
+        llvm::consumeError(json.takeError());
+        return std::nullopt;
+    }
+
+    auto object = json->getAsObject();
+    if (object == nullptr || !object->getString("dynamic_linker").has_value())
+        return std::nullopt;
+
+    LinkerConfig config;
+    config.dynamic_linker = object->getString("dynamic_linker")->str();
+    config.start_files = toStrings(object->getArray("start_files"));
+    config.end_files = toStrings(object->getArray("end_files"));
+    config.library_paths = toStrings(object->getArray("library_paths"));
+    config.libraries = toStrings(object->getArray("libraries"));
+
+    return config;
+}
+
+void LinkerConfig::Store(const std::string &path) const {
+    if (llvm::sys::fs::create_directories(llvm::sys::path::parent_path(path)))
+        return;
+
+    auto toArray = [](const std::vector<std::string> &strings) {
+        llvm::json::Array array;
+        for (const auto &str: strings)
+            array.push_back(str);
+
+        return array;
+    };
+
+    llvm::json::Object object{
+            {"dynamic_linker", dynamic_linker},
+            {"start_files", toArray(start_files)},
+            {"end_files", toArray(end_files)},
+            {"library_paths", toArray(library_paths)},
+            {"libraries", toArray(libraries)},
+    };
+
+    // Failures are ignored, the configuration is discovered again next time
+    ModuleCache::WriteAtomically(path, [&object](llvm::raw_ostream &out) { out << llvm::json::Value(std::move(object)); });
+}
+
+bool LinkerConfig::Exists() const {
+    if (!llvm::sys::fs::exists(dynamic_linker))
+        return false;
+
+    for (const auto &file: start_files) {
+        if (!llvm::sys::fs::exists(file))
+            return false;
+    }
+
+    for (const auto &file: end_files) {
+        if (!llvm::sys::fs::exists(file))
+            return false;
+    }
+
+    return true;
+}
\ No newline at end of file
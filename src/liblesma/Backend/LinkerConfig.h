@@ -0,0 +1,30 @@
+#pragma once
+
+#include <llvm/ADT/Triple.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "liblesma/Common/Utils.h"
+
+namespace lesma {
+    /**
+     * C runtime objects and library paths needed to link an executable with LLD for an ELF target.
+     * They're discovered from the filesystem once, and cached for later compilations.
+     */
+    struct LinkerConfig {
+        std::string dynamic_linker;
+        std::vector<std::string> start_files;
+        std::vector<std::string> end_files;
+        std::vector<std::string> library_paths;
+        std::vector<std::string> libraries;
+
+        static std::optional<LinkerConfig> Get(const llvm::Triple &triple, const std::string &directory = getCacheDir());
+
+    private:
+        static std::optional<LinkerConfig> Discover(const llvm::Triple &triple);
+        static std::optional<LinkerConfig> Load(const std::string &path);
+        void Store(const std::string &path) const;
+        [[nodiscard]] bool Exists() const;
+    };
+}// namespace lesma
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "LinkerInputs.h"
+
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "liblesma/Common/LesmaError.h"
+#include "liblesma/Common/Utils.h"
+
+using namespace lesma;
+
+/**
+ * Prepare the objects of a link
+ *
+ * @param objects Objects emitted in memory
+ * @param files Paths of the objects already on disk
+ * @param in_process Whether the linker runs in this process, which can read its memory files
+ */
+LinkerInputs::LinkerInputs(const std::vector<llvm::SmallVector<char, 0>> &objects, const std::vector<std::string> &files, bool in_process) {
+    // The destructor isn't run if the constructor throws, the files added so far are released here
+    try {
+        for (const auto &object: objects) {
+            llvm::StringRef contents(object.data(), object.size());
+            if (!in_process || !AddMemoryFile(contents))
+                AddTemporaryFile(contents);
+        }
+    } catch (...) {
+        Release();
+        throw;
+    }
+
+    paths.insert(paths.end(), files.begin(), files.end());
+}
+
+LinkerInputs::~LinkerInputs() {
+    Release();
+}
+
+void LinkerInputs::Release() {
+    for (auto fd: memory_files)
+        close(fd);
+    for (const auto &file: temporary_files)
+        llvm::sys::fs::remove(file);
+
+    memory_files.clear();
+    temporary_files.clear();
+}
+
+bool LinkerInputs::AddMemoryFile(llvm::StringRef object) {
+#ifdef __linux__
+    int fd = memfd_create("lesma.o", MFD_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    for (size_t written = 0; written < object.size();) {
+        auto result = write(fd, object.data() + written, object.size() - written);
+        if (result < 0) {
+            close(fd);
+            return false;
+        }
+        written += result;
+    }
+
+    memory_files.push_back(fd);
+    paths.push_back(fmt::format("/proc/self/fd/{}", fd));
+    return true;
+#else
+    return false;
+#endif
+}
+
+void LinkerInputs::AddTemporaryFile(llvm::StringRef object) {
+    int fd;
+    llvm::SmallString<128> path;
+    if (auto err = llvm::sys::fs::createTemporaryFile("lesma", "o", fd, path))
+        throw LesmaError(llvm::SMRange(), "Unable to create a temporary object file: {}", err.message());
+
+    temporary_files.push_back(path.str().str());
+    paths.push_back(path.str().str());
+
+    llvm::raw_fd_ostream out(fd, true);
+    out << object;
+    out.close();
+    if (out.has_error()) {
+        out.clear_error();
+        throw LesmaError(llvm::SMRange(), "Unable to write the temporary object file {}", path.str());
+    }
+}
\ No newline at end of file
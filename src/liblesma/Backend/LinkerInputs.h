@@ -0,0 +1,33 @@
+#pragma once
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <string>
+#include <vector>
+
+namespace lesma {
+    /**
+     * Paths of the objects passed to a linker. Objects emitted in memory are exposed through anonymous
+     * memory files when linking in-process, or through unique temporary files under $TMPDIR otherwise,
+     * which are all released once the inputs are destroyed.
+     */
+    class LinkerInputs {
+    public:
+        LinkerInputs(const std::vector<llvm::SmallVector<char, 0>> &objects, const std::vector<std::string> &files, bool in_process);
+        ~LinkerInputs();
+
+        LinkerInputs(const LinkerInputs &) = delete;
+        LinkerInputs &operator=(const LinkerInputs &) = delete;
+
+        [[nodiscard]] const std::vector<std::string> &getPaths() const { return paths; }
+
+    private:
+        std::vector<std::string> paths;
+        std::vector<int> memory_files;
+        std::vector<std::string> temporary_files;
+
+        void Release();
+        bool AddMemoryFile(llvm::StringRef object);
+        void AddTemporaryFile(llvm::StringRef object);
+    };
+}// namespace lesma
\ No newline at end of file
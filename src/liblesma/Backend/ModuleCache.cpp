@@ -0,0 +1,262 @@
+#include "ModuleCache.h"
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <mutex>
+#include <unistd.h>
+
+#include "liblesma/Common/LesmaVersion.h"
+
+using namespace lesma;
+
+// Entries kept in memory by this process, they never change since they're identified by their contents
+static std::mutex memory_mutex;
+static bool keep_in_memory = false;
+static llvm::StringMap<std::string> memory_entries;
+
+/**
+ * Keep the entries read or written by this process in memory, for processes which compile many programs.
+ * Forked processes start with the entries of their parent, but the entries they add are lost with them.
+ */
+void ModuleCache::KeepInMemory() {
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    keep_in_memory = true;
+}
+
+/**
+ * Compute the cache key of a module
+ *
+ * @param source Source code of the module
+ * @param alias Alias used to mangle the names of the module
+ * @param target Triple, CPU and features the module is compiled for
+ * @param opt Optimization level the module is compiled with
+ * @param lto Link time optimization the module is prepared for
+ * @return Hex digest identifying the compiled module
+ */
+std::string ModuleCache::getKey(llvm::StringRef source, llvm::StringRef alias, llvm::StringRef target, const llvm::OptimizationLevel &opt, LTOKind lto) {
+    auto opt_level = fmt::format("O{}s{}lto{}", opt.getSpeedupLevel(), opt.getSizeLevel(), static_cast<int>(lto));
+
+    llvm::MD5 hash;
+    for (auto part: {llvm::StringRef(LESMA_VERSION), target, llvm::StringRef(opt_level), alias, source}) {
+        hash.update(part);
+        // Separate the parts, so they can't be shifted into each other
+        hash.update(llvm::ArrayRef<uint8_t>{0});
+    }
+
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+
+    return result.digest().str().str();
+}
+
+std::optional<ModuleInterface> ModuleCache::LoadInterface(const std::string &key) const {
+    auto buffer = Read(getPath(key, "json"));
+    if (buffer == nullptr)
+        return std::nullopt;
+
+    return ModuleInterface::Parse(buffer->getBuffer());
+}
+
+std::unique_ptr<llvm::Module> ModuleCache::LoadModule(const std::string &key, llvm::LLVMContext &context) const {
+    auto buffer = Read(getPath(key, "bc"));
+    if (buffer == nullptr)
+        return nullptr;
+
+    auto module = llvm::parseBitcodeFile(buffer->getMemBufferRef(), context);
+    if (!module) {
+        llvm::consumeError(module.takeError());
+        return nullptr;
+    }
+
+    return std::move(*module);
+}
+
+/**
+ * Check that the modules imported by a cached module did not change since it was compiled
+ *
+ * @param interface Interface of the cached module
+ * @param target Triple, CPU and features the module is compiled for
+ * @param opt Optimization level the module is compiled with
+ * @param lto Link time optimization the module is prepared for
+ * @return Whether the cached module can be used
+ */
+bool ModuleCache::IsUpToDate(const ModuleInterface &interface, llvm::StringRef target, const llvm::OptimizationLevel &opt, LTOKind lto) const {
+    for (const auto &dependency: interface.getDependencies()) {
+        auto buffer = llvm::MemoryBuffer::getFile(dependency.path);
+        if (!buffer || getKey((*buffer)->getBuffer(), dependency.alias, target, opt, lto) != dependency.key)
+            return false;
+
+        auto dependency_interface = LoadInterface(dependency.key);
+        if (!dependency_interface.has_value() || !IsUpToDate(*dependency_interface, target, opt, lto))
+            return false;
+    }
+
+    return true;
+}
+
+bool ModuleCache::HasObject(const std::string &key) const {
+    if (!llvm::sys::fs::exists(getObjectPath(key)))
+        return false;
+
+    // The object is linked later, it mustn't look unused to a concurrent pruning
+    Touch(getObjectPath(key));
+    return true;
+}
+
+std::unique_ptr<llvm::MemoryBuffer> ModuleCache::LoadObject(const std::string &key) const {
+    return Read(getObjectPath(key));
+}
+
+/**
+ * Store a compiled module, failures are ignored since the cache is only an optimization
+ *
+ * @param key Key of the module
+ * @param module Optimized module
+ * @param interface Interface of the module
+ */
+void ModuleCache::Store(const std::string &key, const llvm::Module &module, const ModuleInterface &interface) const {
+    if (llvm::sys::fs::create_directories(directory))
+        return;
+
+    // The interface is written last, entries without one are never read
+    if (!Write(getPath(key, "bc"), [&module](llvm::raw_ostream &out) { llvm::WriteBitcodeToFile(module, out); }))
+        return;
+    Write(getPath(key, "json"), [&interface](llvm::raw_ostream &out) { out << interface.Serialize(); });
+
+    Prune();
+}
+
+/**
+ * Store the object file of a cached module
+ *
+ * @param key Key of the module
+ * @param object Contents of the object file
+ * @return Whether the object file is available at getObjectPath
+ */
+bool ModuleCache::StoreObject(const std::string &key, llvm::StringRef object) const {
+    if (llvm::sys::fs::create_directories(directory))
+        return false;
+
+    bool stored = Write(getObjectPath(key), [&object](llvm::raw_ostream &out) { out << object; });
+    Prune();
+
+    return stored;
+}
+
+/**
+ * Remove the entries unused for a week, then the least recently used ones while the cache is larger than 1 GiB or
+ * than 75% of the available space. The files of an entry are removed independently, an entry missing any of them is
+ * compiled again. The cache is pruned at most once an hour, the time of the last pruning is kept in the directory.
+ */
+void ModuleCache::Prune() const {
+    llvm::CachePruningPolicy policy;
+    policy.Interval = std::chrono::hours(1);
+    policy.Expiration = std::chrono::hours(24 * 7);
+    policy.MaxSizeBytes = 1ULL << 30;
+
+    llvm::pruneCache(directory, policy);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> ModuleCache::Read(const std::string &path) {
+    bool in_memory;
+    {
+        std::lock_guard<std::mutex> lock(memory_mutex);
+        auto it = memory_entries.find(path);
+        if (it != memory_entries.end())
+            return llvm::MemoryBuffer::getMemBufferCopy(it->second, path);
+
+        in_memory = keep_in_memory;
+    }
+
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer)
+        return nullptr;
+    Touch(path);
+
+    if (in_memory) {
+        std::lock_guard<std::mutex> lock(memory_mutex);
+        memory_entries[path] = (*buffer)->getBuffer().str();
+    }
+
+    return std::move(*buffer);
+}
+
+bool ModuleCache::Write(const std::string &path, llvm::function_ref<void(llvm::raw_ostream &)> writer) {
+    bool in_memory;
+    {
+        std::lock_guard<std::mutex> lock(memory_mutex);
+        in_memory = keep_in_memory;
+    }
+
+    if (!in_memory)
+        return WriteAtomically(path, writer);
+
+    std::string contents;
+    llvm::raw_string_ostream out(contents);
+    writer(out);
+    out.flush();
+
+    if (!WriteAtomically(path, [&contents](llvm::raw_ostream &file) { file << contents; }))
+        return false;
+
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    memory_entries[path] = std::move(contents);
+    return true;
+}
+
+/**
+ * Mark a file as used, entries are pruned by the last time they were used
+ *
+ * @param path Path of the file
+ */
+void ModuleCache::Touch(const std::string &path) {
+    int fd;
+    if (llvm::sys::fs::openFileForRead(path, fd))
+        return;
+
+    llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+    close(fd);
+}
+
+std::string ModuleCache::getPath(const std::string &key, const std::string &extension) const {
+    // Only files named like the caches of LLVM are pruned
+    return fmt::format("{}/llvmcache-{}.{}", directory, key, extension);
+}
+
+/**
+ * Write a file through a temporary file renamed over it, so readers never see a partial file
+ *
+ * @param path Path of the file
+ * @param writer Function writing the contents of the file
+ * @return Whether the file was written
+ */
+bool ModuleCache::WriteAtomically(const std::string &path, llvm::function_ref<void(llvm::raw_ostream &)> writer) {
+    int fd;
+    llvm::SmallString<128> tmp_path;
+    if (llvm::sys::fs::createUniqueFile(path + ".%%%%%%%%.tmp", fd, tmp_path))
+        return false;
+
+    {
+        llvm::raw_fd_ostream out(fd, true);
+        writer(out);
+        out.close();
+
+        if (out.has_error()) {
+            out.clear_error();
+            llvm::sys::fs::remove(tmp_path);
+            return false;
+        }
+    }
+
+    if (llvm::sys::fs::rename(tmp_path, path)) {
+        llvm::sys::fs::remove(tmp_path);
+        return false;
+    }
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "liblesma/Backend/ModuleGraph.h"
+#include "liblesma/Common/Utils.h"
+#include "liblesma/Symbol/ModuleInterface.h"
+
+namespace lesma {
+    /**
+     * Content-addressed on-disk cache of compiled modules. Every entry holds the optimized bitcode of a module,
+     * its object file once it's compiled ahead-of-time, and the interface of the symbols it exports.
+     * Long-running processes can also keep the entries they read or write in memory. Entries unused for a while, and
+     * the least recently used ones once the cache grows too large, are pruned after storing new ones.
+     */
+    class ModuleCache {
+    public:
+        explicit ModuleCache(std::string directory = getCacheDir()) : directory(std::move(directory)) {}
+
+        static std::string getKey(llvm::StringRef source, llvm::StringRef alias, llvm::StringRef target, const llvm::OptimizationLevel &opt, LTOKind lto);
+
+        [[nodiscard]] std::optional<ModuleInterface> LoadInterface(const std::string &key) const;
+        [[nodiscard]] std::unique_ptr<llvm::Module> LoadModule(const std::string &key, llvm::LLVMContext &context) const;
+        [[nodiscard]] bool IsUpToDate(const ModuleInterface &interface, llvm::StringRef target, const llvm::OptimizationLevel &opt, LTOKind lto) const;
+        [[nodiscard]] bool HasObject(const std::string &key) const;
+        [[nodiscard]] std::unique_ptr<llvm::MemoryBuffer> LoadObject(const std::string &key) const;
+        [[nodiscard]] std::string getObjectPath(const std::string &key) const { return getPath(key, "o"); }
+        void Store(const std::string &key, const llvm::Module &module, const ModuleInterface &interface) const;
+        bool StoreObject(const std::string &key, llvm::StringRef object) const;
+
+        void Prune() const;
+
+        static bool WriteAtomically(const std::string &path, llvm::function_ref<void(llvm::raw_ostream &)> writer);
+        static void KeepInMemory();
+
+    private:
+        std::string directory;
+
+        [[nodiscard]] std::string getPath(const std::string &key, const std::string &extension) const;
+        static std::unique_ptr<llvm::MemoryBuffer> Read(const std::string &path);
+        static void Touch(const std::string &path);
+        static bool Write(const std::string &path, llvm::function_ref<void(llvm::raw_ostream &)> writer);
+    };
+}// namespace lesma
\ No newline at end of file
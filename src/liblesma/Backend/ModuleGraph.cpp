@@ -0,0 +1,89 @@
+#include "ModuleGraph.h"
+
+#include <filesystem>
+
+#include "liblesma/Backend/ModuleCache.h"
+#include "liblesma/Common/LesmaError.h"
+
+using namespace lesma;
+
+/**
+ * Resolve the path of an imported module, files are relative to the importing module
+ *
+ * @param importer Path of the importing module, or empty for sources without a file, which import relative to the working directory
+ * @param filepath Path of the import as written in the source
+ * @param isStd Whether the import is a standard library module, which is already absolute
+ * @return Normalized absolute path of the module
+ */
+std::string ModuleGraph::getImportPath(const std::string &importer, const std::string &filepath, bool isStd) {
+    auto path = isStd ? filepath : fmt::format("{}/{}", std::filesystem::absolute(importer.empty() ? "." : importer).parent_path().c_str(), filepath);
+    return std::filesystem::path(path).lexically_normal().string();
+}
+
+std::string ModuleGraph::getImportAlias(const std::string &alias, bool importToScope) {
+    // Names of the imported module are mangled with its alias, unless imported to scope
+    return !importToScope ? alias : "";
+}
+
+ModuleNode *ModuleGraph::Find(const std::string &path, const std::string &alias) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = Nodes.find({path, alias});
+    return it == Nodes.end() ? nullptr : &it->second;
+}
+
+/**
+ * Read the source of a module and insert it into the graph, unless it's already there
+ *
+ * @param path Absolute path of the module
+ * @param alias Alias used to mangle the names of the module
+ * @return Node of the module
+ */
+ModuleNode *ModuleGraph::Load(const std::string &path, const std::string &alias) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = Nodes.find({path, alias});
+    if (it != Nodes.end())
+        return &it->second;
+
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (std::error_code ec = buffer.getError())
+        throw LesmaError(llvm::SMRange(), "Could not read file: {}", path);
+
+    auto sourceMgr = std::make_shared<llvm::SourceMgr>();
+    auto file_id = sourceMgr->AddNewSourceBuffer(std::move(*buffer), llvm::SMLoc());
+    auto key = ModuleCache::getKey(sourceMgr->getMemoryBuffer(file_id)->getBuffer(), alias, getTarget(), opt, lto);
+
+    it = Nodes.try_emplace({path, alias}, ModuleNode{path, alias, key, sourceMgr, {}, std::nullopt}).first;
+    return &it->second;
+}
+
+std::vector<ModuleNode *> ModuleGraph::getNodes() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<ModuleNode *> nodes;
+    for (auto &[id, node]: Nodes)
+        nodes.push_back(&node);
+
+    return nodes;
+}
+
+void ModuleGraph::AddModule(llvm::orc::ThreadSafeModule module) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Modules.push_back(std::move(module));
+}
+
+void ModuleGraph::AddObjectFile(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ObjectFiles.push_back(path);
+}
+
+void ModuleGraph::AddObject(llvm::SmallVector<char, 0> object) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Objects.push_back(std::move(object));
+}
+
+std::vector<llvm::orc::ThreadSafeModule> ModuleGraph::TakeModules() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::move(Modules);
+}
\ No newline at end of file
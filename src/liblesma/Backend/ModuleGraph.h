@@ -0,0 +1,99 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/SourceMgr.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "liblesma/Common/Utils.h"
+#include "liblesma/Symbol/ModuleInterface.h"
+
+namespace lesma {
+    /**
+     * Link time optimization of a compilation. Modules are kept as bitcode until they're all compiled, and are then
+     * either linked into a single module or optimized together through ThinLTO summaries.
+     */
+    enum class LTOKind {
+        None,
+        Full,
+        Thin,
+    };
+
+    /**
+     * Module imported during a compilation. Its source and imports are loaded when it's discovered,
+     * and its interface is set once it's compiled.
+     */
+    struct ModuleNode {
+        std::string path;
+        std::string alias;
+        std::string key;
+        std::shared_ptr<llvm::SourceMgr> sourceMgr;
+        std::vector<ModuleNode *> imports;
+        std::optional<ModuleInterface> interface;
+    };
+
+    /**
+     * Graph of the modules imported during a single compilation. It's owned by the driver and shared by the
+     * code generators of all modules, so each module is compiled once no matter how many modules import it,
+     * and the compiled modules are collected in one place to be added to the JIT or linked.
+     */
+    class ModuleGraph {
+    public:
+        explicit ModuleGraph(llvm::OptimizationLevel opt = llvm::OptimizationLevel::O3, llvm::CodeGenOpt::Level codegen_opt = llvm::CodeGenOpt::Aggressive,
+                             std::string cpu = "generic", std::string features = "", LTOKind lto = LTOKind::None, unsigned threads = 0, std::string cache_dir = getCacheDir(),
+                             std::string triple = llvm::sys::getDefaultTargetTriple())
+            : opt(opt), codegen_opt(codegen_opt), cpu(std::move(cpu)), features(std::move(features)), lto(lto), threads(threads), cache_dir(std::move(cache_dir)), triple(std::move(triple)) {}
+
+        static std::string getImportPath(const std::string &importer, const std::string &filepath, bool isStd);
+        static std::string getImportAlias(const std::string &alias, bool importToScope);
+
+        ModuleNode *Find(const std::string &path, const std::string &alias);
+        ModuleNode *Load(const std::string &path, const std::string &alias);
+        std::vector<ModuleNode *> getNodes();
+
+        void AddModule(llvm::orc::ThreadSafeModule module);
+        void AddObjectFile(const std::string &path);
+        void AddObject(llvm::SmallVector<char, 0> object);
+        std::vector<llvm::orc::ThreadSafeModule> TakeModules();
+
+        [[nodiscard]] const llvm::OptimizationLevel &getOptimizationLevel() const { return opt; }
+        [[nodiscard]] llvm::CodeGenOpt::Level getCodeGenOptLevel() const { return codegen_opt; }
+        [[nodiscard]] const std::string &getCPU() const { return cpu; }
+        [[nodiscard]] const std::string &getFeatures() const { return features; }
+        [[nodiscard]] LTOKind getLTO() const { return lto; }
+        [[nodiscard]] unsigned getThreads() const { return threads; }
+        [[nodiscard]] const std::string &getCacheDirectory() const { return cache_dir; }
+        [[nodiscard]] const std::string &getTriple() const { return triple; }
+        [[nodiscard]] std::string getTarget() const { return fmt::format("{}:{}:{}", triple, cpu, features); }
+        [[nodiscard]] const std::vector<std::string> &getObjectFiles() const { return ObjectFiles; }
+        [[nodiscard]] const std::vector<llvm::SmallVector<char, 0>> &getObjects() const { return Objects; }
+
+    private:
+        // Every module of a compilation is optimized and compiled for the same target
+        llvm::OptimizationLevel opt;
+        llvm::CodeGenOpt::Level codegen_opt;
+        std::string cpu;
+        std::string features;
+        LTOKind lto;
+        // Threads of the parallel phases, 0 for every core
+        unsigned threads;
+        // Directory of the module, object and linker caches
+        std::string cache_dir;
+        std::string triple;
+        std::mutex mutex;
+
+        // Modules are identified by their absolute path and the alias their names are mangled with
+        std::map<std::pair<std::string, std::string>, ModuleNode> Nodes;
+        std::vector<llvm::orc::ThreadSafeModule> Modules;
+        std::vector<std::string> ObjectFiles;
+        std::vector<llvm::SmallVector<char, 0>> Objects;
+    };
+}// namespace lesma
\ No newline at end of file
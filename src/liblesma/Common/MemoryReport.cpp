@@ -0,0 +1,135 @@
+#include "MemoryReport.h"
+
+#include <algorithm>
+#include <fstream>
+#include <llvm/IR/Module.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+#include "Utils.h"
+
+using namespace lesma;
+
+std::array<MemoryReport::Counter, static_cast<size_t>(MemoryCategory::Count)> MemoryReport::counters;
+std::atomic<bool> MemoryReport::enabled = false;
+
+static constexpr const char *CATEGORY_NAMES[] = {"Tokens", "AST nodes", "Values", "Types", "Symbol tables", "LLVM IR"};
+
+static double toMiB(size_t bytes) {
+    return static_cast<double>(bytes) / (1024 * 1024);
+}
+
+static size_t getResidentBytes() {
+#ifdef __APPLE__
+    mach_task_basic_info_data_t info{};
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return info.resident_size;
+#else
+    size_t pages = 0, resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static size_t getPeakResidentBytes() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    // The peak is in bytes on macOS, and in kilobytes elsewhere
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+static void subtract(std::atomic<size_t> &counter, size_t value) {
+    // Objects allocated before the report was enabled, like the standard library of a server, weren't counted
+    auto current = counter.load(std::memory_order_relaxed);
+    while (!counter.compare_exchange_weak(current, current - std::min(current, value), std::memory_order_relaxed)) {
+    }
+}
+
+void MemoryReport::Allocate(MemoryCategory category, size_t bytes, size_t objects) {
+    auto &counter = counters[static_cast<size_t>(category)];
+    counter.objects.fetch_add(objects, std::memory_order_relaxed);
+    counter.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    counter.live_objects.fetch_add(objects, std::memory_order_relaxed);
+    counter.live_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void MemoryReport::Deallocate(MemoryCategory category, size_t bytes, size_t objects) {
+    auto &counter = counters[static_cast<size_t>(category)];
+    subtract(counter.live_objects, objects);
+    subtract(counter.live_bytes, bytes);
+}
+
+/**
+ * Count the IR of a module after codegen, each instruction with its operands, each basic block, function and global
+ *
+ * @param module Module to count
+ */
+void MemoryReport::AddModule(const llvm::Module &module) {
+    size_t objects = 0, bytes = 0;
+    for (const auto &global: module.globals()) {
+        objects++;
+        bytes += sizeof(llvm::GlobalVariable) + global.getNumOperands() * sizeof(llvm::Use);
+    }
+
+    for (const auto &function: module) {
+        objects++;
+        bytes += sizeof(llvm::Function) + function.arg_size() * sizeof(llvm::Argument);
+        for (const auto &block: function) {
+            objects++;
+            bytes += sizeof(llvm::BasicBlock);
+            for (const auto &instruction: block) {
+                objects++;
+                bytes += sizeof(llvm::Instruction) + instruction.getNumOperands() * sizeof(llvm::Use);
+            }
+        }
+    }
+
+    // The IR isn't tracked once it's freed
+    auto &counter = counters[static_cast<size_t>(MemoryCategory::IR)];
+    counter.objects.fetch_add(objects, std::memory_order_relaxed);
+    counter.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * Print the resident memory after a phase, and the memory of the objects it allocated which are still alive
+ *
+ * @param phase Name of the phase
+ */
+void MemoryReport::PrintPhase(const std::string &phase) {
+    size_t live_bytes = 0;
+    for (const auto &counter: counters)
+        live_bytes += counter.live_bytes.load(std::memory_order_relaxed);
+
+    print(DEBUG, "{} -> RSS {:.2f} MiB, peak RSS {:.2f} MiB, live objects {:.2f} MiB\n",
+          phase, toMiB(getResidentBytes()), toMiB(getPeakResidentBytes()), toMiB(live_bytes));
+}
+
+/**
+ * Print the objects and bytes allocated in each category, in total and still alive
+ */
+void MemoryReport::PrintCategories() {
+    print(DEBUG, "{:<14} {:>12} {:>12} {:>12} {:>12}\n", "Category", "Objects", "MiB", "Live", "Live MiB");
+    for (size_t i = 0; i < counters.size(); i++) {
+        const auto &counter = counters[i];
+        if (static_cast<MemoryCategory>(i) == MemoryCategory::IR) {
+            print(DEBUG, "{:<14} {:>12} {:>12.2f} {:>12} {:>12}\n", CATEGORY_NAMES[i], counter.objects.load(),
+                  toMiB(counter.bytes.load()), "-", "-");
+            continue;
+        }
+
+        print(DEBUG, "{:<14} {:>12} {:>12.2f} {:>12} {:>12.2f}\n", CATEGORY_NAMES[i], counter.objects.load(),
+              toMiB(counter.bytes.load()), counter.live_objects.load(), toMiB(counter.live_bytes.load()));
+    }
+    print(DEBUG, "Peak RSS -> {:.2f} MiB\n", toMiB(getPeakResidentBytes()));
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <string>
+
+namespace llvm {
+    class Module;
+}// namespace llvm
+
+namespace lesma {
+    enum class MemoryCategory {
+        Tokens,
+        ASTNodes,
+        Values,
+        Types,
+        SymbolTables,
+        IR,
+        Count
+    };
+
+    /**
+     * Memory used by the compiler, in objects and bytes per category and in resident memory per phase. Objects are
+     * counted by the allocations of MemoryTracked classes, with the size of the object itself but not of the strings
+     * and containers it owns, tokens by the arenas of the lexers, and the IR by the modules added after codegen.
+     * Counters are shared by the whole process.
+     */
+    class MemoryReport {
+    public:
+        static void Enable() { enabled = true; }
+        static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+        static void Allocate(MemoryCategory category, size_t bytes, size_t objects = 1);
+        static void Deallocate(MemoryCategory category, size_t bytes, size_t objects = 1);
+        static void AddModule(const llvm::Module &module);
+
+        static void PrintPhase(const std::string &phase);
+        static void PrintCategories();
+
+    private:
+        struct Counter {
+            std::atomic<size_t> objects = 0;
+            std::atomic<size_t> bytes = 0;
+            std::atomic<size_t> live_objects = 0;
+            std::atomic<size_t> live_bytes = 0;
+        };
+
+        static std::array<Counter, static_cast<size_t>(MemoryCategory::Count)> counters;
+        static std::atomic<bool> enabled;
+    };
+
+    /**
+     * Base of the classes counted by MemoryReport, the size of derived classes is counted when they're allocated.
+     * Allocations only check a flag unless the report is enabled.
+     */
+    template<MemoryCategory Category>
+    class MemoryTracked {
+    public:
+        static void *operator new(size_t size) {
+            if (MemoryReport::isEnabled())
+                MemoryReport::Allocate(Category, size);
+            return ::operator new(size);
+        }
+
+        static void operator delete(void *ptr, size_t size) {
+            if (MemoryReport::isEnabled())
+                MemoryReport::Deallocate(Category, size);
+            ::operator delete(ptr);
+        }
+    };
+}// namespace lesma
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "TimeTrace.h"
+
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "LesmaError.h"
+
+using namespace lesma;
+
+std::atomic<unsigned> TimeTrace::granularity = 500;
+
+/**
+ * Start tracing the current thread, nothing is traced if the path is empty
+ *
+ * @param path Path of the JSON trace
+ * @param granularity Minimum duration of the traced events, in microseconds
+ */
+TimeTrace::TimeTrace(std::string path, unsigned granularity) : path(std::move(path)) {
+    if (this->path.empty())
+        return;
+
+    TimeTrace::granularity = granularity;
+    llvm::timeTraceProfilerInitialize(granularity, "lesma");
+}
+
+TimeTrace::~TimeTrace() {
+    if (!path.empty())
+        llvm::timeTraceProfilerCleanup();
+}
+
+/**
+ * Write the trace of the current thread and of the finished tasks, all events must be ended
+ */
+void TimeTrace::Write() {
+    if (path.empty())
+        return;
+
+    std::error_code error;
+    llvm::raw_fd_ostream out(path, error, llvm::sys::fs::OF_TextWithCRLF);
+    if (error)
+        throw LesmaError({}, "Unable to write time trace to {}: {}", path, error.message());
+
+    llvm::timeTraceProfilerWrite(out);
+}
+
+/**
+ * Start tracing a task on the current thread
+ *
+ * @param enabled Whether the thread creating the task is traced, from llvm::timeTraceProfilerEnabled
+ */
+TimeTraceThread::TimeTraceThread(bool enabled) : enabled(enabled) {
+    if (enabled)
+        llvm::timeTraceProfilerInitialize(TimeTrace::getGranularity(), "lesma");
+}
+
+TimeTraceThread::~TimeTraceThread() {
+    if (enabled)
+        llvm::timeTraceProfilerFinishThread();
+}
\ No newline at end of file
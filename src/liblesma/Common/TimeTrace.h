@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+namespace lesma {
+    /**
+     * Chrome trace of a compilation, written as JSON for chrome://tracing or Perfetto. Phases are traced with
+     * llvm::TimeTraceScope, which also traces every LLVM pass. The profiler of LLVM is per thread, so the tasks of
+     * thread pools are traced with a TimeTraceThread and merged into the trace when it's written.
+     */
+    class TimeTrace {
+    public:
+        TimeTrace(std::string path, unsigned granularity);
+        ~TimeTrace();
+
+        TimeTrace(const TimeTrace &) = delete;
+        TimeTrace &operator=(const TimeTrace &) = delete;
+
+        void Write();
+
+        static unsigned getGranularity() { return granularity; }
+
+    private:
+        std::string path;
+
+        static std::atomic<unsigned> granularity;
+    };
+
+    /**
+     * Traces a task running on a thread pool, if the thread which created the task is traced
+     */
+    class TimeTraceThread {
+    public:
+        explicit TimeTraceThread(bool enabled);
+        ~TimeTraceThread();
+
+        TimeTraceThread(const TimeTraceThread &) = delete;
+        TimeTraceThread &operator=(const TimeTraceThread &) = delete;
+
+    private:
+        bool enabled;
+    };
+}// namespace lesma
\ No newline at end of file
@@ -43,14 +43,18 @@ namespace lesma {
         }
     }
 
-    std::string getStdDir() {
-        std::string homedir;
-
+    static std::string getHomeDir() {
         if (getenv("HOME"))
-            homedir = getenv("HOME");
-        else
-            homedir = getpwuid(getuid())->pw_dir;
+            return getenv("HOME");
+
+        return getpwuid(getuid())->pw_dir;
+    }
+
+    std::string getStdDir() {
+        return getHomeDir() + "/.lesma/stdlib/";
+    }
 
-        return homedir + "/.lesma/stdlib/";
+    std::string getCacheDir() {
+        return getHomeDir() + "/.lesma/cache/";
     }
 }// namespace lesma
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <pwd.h>
 #include <sstream>
 #include <unistd.h>
+#include <vector>
 
 #include "llvm/Support/SMLoc.h"
 #include "llvm/Support/SourceMgr.h"
@@ -24,11 +25,28 @@ namespace lesma {
     };
 
     struct CLIOptions {
-        std::string file;
+        std::vector<std::string> files;
         std::string output;
         bool debug;
         bool timer;
         bool jit;
+        unsigned partitions;
+        bool lazy;
+        std::string optimization;
+        std::string cpu;
+        std::string features;
+        std::vector<std::string> multiversion;
+        std::string lto;
+        bool serve;
+        std::string socket;
+        std::string server;
+        unsigned jobs;
+        bool incremental;
+        bool repl;
+        std::string time_trace;
+        unsigned time_trace_granularity;
+        bool mem_report;
+        std::string cache_dir;
     };
 
     template<typename S, typename... Args>
@@ -53,4 +71,5 @@ namespace lesma {
     void showInline(llvm::SourceMgr *srcMgr, unsigned int bufferId, llvm::SMRange span, const std::string &reason, const std::string &file, bool is_error);
     std::string getBasename(const std::string &file_path);
     std::string getStdDir();
+    std::string getCacheDir();
 }// namespace lesma
\ No newline at end of file
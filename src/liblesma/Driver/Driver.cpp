@@ -1,16 +1,33 @@
 #include "Driver.h"
+#include "Session.h"
 
+#include "liblesma/Common/MemoryReport.h"
+#include "liblesma/Common/TimeTrace.h"
 #include "plf_nanotimer.h"
 
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <mutex>
+#include <regex>
+#include <set>
+
 using namespace lesma;
 
-#define TIMEIT(debug_operation, statements)   \
-    timer.start();                            \
-    statements                                \
-            results = timer.get_elapsed_ms(); \
-    total += results;                         \
-    if (options->timer)                       \
-        print(DEBUG, "{} -> {:.2f} ms\n", debug_operation, results);
+#define TIMEIT(debug_operation, statements)                           \
+    timer.start();                                                    \
+    llvm::timeTraceProfilerBegin(debug_operation, "");                \
+    statements                                                        \
+            llvm::timeTraceProfilerEnd();                             \
+    results = timer.get_elapsed_ms();                                 \
+    total += results;                                                 \
+    if (options->timer)                                               \
+        print(DEBUG, "{} -> {:.2f} ms\n", debug_operation, results); \
+    if (options->mem_report)                                          \
+        MemoryReport::PrintPhase(debug_operation);
 
 
 int Driver::BaseCompile(std::unique_ptr<lesma::Options> options, bool jit) {
@@ -21,6 +38,13 @@ int Driver::BaseCompile(std::unique_ptr<lesma::Options> options, bool jit) {
     // Configure Source Manager
     std::shared_ptr<llvm::SourceMgr> srcMgr = std::make_shared<llvm::SourceMgr>(llvm::SourceMgr());
 
+    // Configure Time Trace, phases are traced by TIMEIT
+    TimeTrace trace(options->time_trace, options->time_trace_granularity);
+
+    // Configure Memory Report, the IR of every module is counted after codegen
+    if (options->mem_report)
+        MemoryReport::Enable();
+
     try {
         // Read Source
         TIMEIT(
@@ -37,31 +61,36 @@ int Driver::BaseCompile(std::unique_ptr<lesma::Options> options, bool jit) {
                     srcMgr->AddNewSourceBuffer(std::move(buffer), llvm::SMLoc());
                 })
 
-        // Lexer
-        TIMEIT("Lexer scan",
-               auto lexer = std::make_unique<Lexer>(srcMgr);
-               lexer->ScanAll();)
-
+        // Lexer, the tokens are only scanned ahead of the parser to be dumped
+        auto lexer = std::make_unique<Lexer>(srcMgr);
         if (options->debug & LEXER) {
+            TIMEIT("Lexer scan", lexer->ScanAll();)
+
             print(DEBUG, "TOKENS: \n");
-            for (const auto &tok: lexer->getTokens())
-                print("Token: {}\n", tok->Dump(srcMgr));
+            const auto &tokens = lexer->getTokens();
+            for (size_t i = 0; i < tokens.size(); i++)
+                print("Token: {}\n", tokens[i].Dump(srcMgr));
         }
 
-        // Parser
-        TIMEIT("Parsing",
-               auto parser = std::make_unique<Parser>(lexer->getTokens());
+        // Parser, scanning the tokens as it reads them
+        TIMEIT("Lexing and parsing",
+               auto parser = std::make_unique<Parser>(*lexer);
                parser->Parse();)
 
         if (options->debug & AST)
             print(DEBUG, "AST:\n{}", parser->getAST()->toString(srcMgr.get(), "", true));
 
+        // Imports
+        auto filename = options->sourceType == FILE ? options->source : "";
+        auto graph = CreateModuleGraph(*options, jit);
+        auto opt = graph->getOptimizationLevel();
+        auto lto = graph->getLTO();
+        TIMEIT("Discovering imports", DiscoverModules(graph, filename, parser->getAST());)
+        TIMEIT("Compiling imports", CompileModules(graph, jit);)
+
         // Codegen
         TIMEIT("Compiling",
-               std::vector<std::string> modules;
-               auto codegen = std::make_unique<Codegen>(std::move(parser), srcMgr,
-                                                        options->sourceType == FILE ? options->source : "",
-                                                        modules, jit, true);
+               auto codegen = std::make_unique<Codegen>(std::move(parser), srcMgr, filename, graph, jit, true);
                codegen->Run();)
 
         if (options->debug & IR) {
@@ -69,25 +98,50 @@ int Driver::BaseCompile(std::unique_ptr<lesma::Options> options, bool jit) {
             codegen->Dump();
         }
 
-        // Optimization
-        TIMEIT("Optimizing", codegen->Optimize(OptimizationLevel::O3);)
+        // Multiversioning, the variants are optimized for their features
+        if (!jit && !options->multiversion.empty()) {
+            TIMEIT("Multiversioning", codegen->MultiversionFunctions(options->multiversion);)
+        }
+
+        // Optimization, partitioned modules and functions compiled incrementally are optimized in parallel
+        // while they're compiled, unless the whole program is optimized at link time
+        bool incremental = !jit && options->incremental && lto == LTOKind::None;
+        bool partitioned = !jit && options->partitions > 1;
+        if ((!partitioned && !incremental) || lto != LTOKind::None) {
+            TIMEIT("Optimizing", codegen->Optimize(opt);)
+        }
+
+        if (lto == LTOKind::Full) {
+            TIMEIT("Linking and Optimizing Modules", codegen->LinkModules(opt);)
+        }
 
         int exit_code = 0;
         if (!jit) {
-            // Compile to Object File
-            TIMEIT("Writing Object File", codegen->WriteToObjectFile(options->output_filename);)
+            // Compile to in-memory Object Files, the linked program is only split to be compiled in parallel
+            if (incremental) {
+                TIMEIT("Optimizing and Emitting Changed Functions", codegen->EmitObjectFilesIncrementally(opt);)
+            } else if (lto == LTOKind::Thin) {
+                TIMEIT("Optimizing and Emitting Object Files with ThinLTO", codegen->EmitObjectFilesWithThinLTO(opt);)
+            } else if (partitioned) {
+                TIMEIT("Optimizing and Emitting Object Files", codegen->EmitObjectFiles(options->partitions, lto == LTOKind::Full ? OptimizationLevel::O0 : opt);)
+            } else {
+                TIMEIT("Emitting Object File", codegen->EmitObjectFile();)
+            }
 
-            // Link Object File
-            TIMEIT("Linking Object File", codegen->LinkObjectFile(fmt::format("{}.o", options->output_filename));)
+            // Link Object Files
+            TIMEIT("Linking Object Files", codegen->LinkObjectFiles(options->output_filename);)
         } else {
             // Executing
-            TIMEIT("JIT", codegen->PrepareJIT();)
+            TIMEIT("JIT", codegen->PrepareJIT(options->lazy);)
             TIMEIT("Execution", exit_code = codegen->ExecuteJIT();)
         }
 
         if (options->timer)
             print(DEBUG, "Total -> {:.2f} ms\n", total);
+        if (options->mem_report)
+            MemoryReport::PrintCategories();
 
+        trace.Write();
         return exit_code;
     } catch (const LesmaError &err) {
         if (!err.getSpan().isValid())
@@ -98,6 +152,254 @@ int Driver::BaseCompile(std::unique_ptr<lesma::Options> options, bool jit) {
     }
 }
 
+/**
+ * Create the graph of a compilation, every module is compiled with the same options
+ *
+ * @param options Options of the compilation
+ * @param jit Whether the modules will be executed by the JIT
+ * @return Graph of the compilation
+ */
+std::shared_ptr<ModuleGraph> Driver::CreateModuleGraph(const Options &options, bool jit) {
+    // The JIT defaults to light optimizations and fast instruction selection, for low latency
+    auto opt = options.optimization.value_or(jit ? OptimizationLevel::O1 : OptimizationLevel::O3);
+    auto codegen_opt = jit && !options.optimization.has_value() ? CodeGenOpt::None : Codegen::getCodeGenOptLevel(opt);
+    auto cpu = options.cpu == "native" ? llvm::sys::getHostCPUName().str() : options.cpu;
+    auto features = options.features == "native" || (options.cpu == "native" && options.features.empty()) ? Codegen::getHostCPUFeatures() : options.features;
+    // Modules executed by the JIT are optimized on their own
+    auto lto = jit ? LTOKind::None : options.lto;
+
+    return std::make_shared<ModuleGraph>(opt, codegen_opt, cpu, features, lto, options.threads, options.cache_dir);
+}
+
+/**
+ * Discover the modules imported by the main module and by each other. Modules with an up-to-date interface in the
+ * cache import its recorded dependencies, the others are scanned for their import statements only.
+ *
+ * @param graph Graph of the current compilation
+ * @param filename Path of the main module, imports are relative to it
+ * @param ast Parsed main module
+ */
+void Driver::DiscoverModules(const std::shared_ptr<ModuleGraph> &graph, const std::string &filename, Compound *ast) {
+    auto base_path = getStdDir() + "base.les";
+    ModuleCache cache(graph->getCacheDirectory());
+    std::set<ModuleNode *> discovered;
+    std::vector<ModuleNode *> worklist;
+
+    auto discover = [&](std::vector<ModuleNode *> nodes) {
+        for (auto node: nodes) {
+            if (discovered.insert(node).second)
+                worklist.push_back(node);
+        }
+
+        return nodes;
+    };
+
+    // Every module except the standard library base imports it to scope
+    auto getImports = [&](const std::string &importer, const std::vector<Import *> &imports) {
+        std::vector<ModuleNode *> nodes;
+        if (importer.empty() || std::filesystem::absolute(importer) != base_path)
+            nodes.push_back(graph->Load(base_path, ""));
+
+        for (auto import: imports) {
+            auto path = ModuleGraph::getImportPath(importer, import->getFilePath(), import->isStd());
+            auto alias = ModuleGraph::getImportAlias(import->getAlias(), import->getImportScope());
+            nodes.push_back(graph->Load(path, alias));
+        }
+
+        return discover(nodes);
+    };
+
+    std::vector<Import *> main_imports;
+    for (auto statement: ast->getChildren()) {
+        if (auto import = dynamic_cast<Import *>(statement))
+            main_imports.push_back(import);
+    }
+    getImports(filename, main_imports);
+
+    while (!worklist.empty()) {
+        auto node = worklist.back();
+        worklist.pop_back();
+        llvm::TimeTraceScope scope("Discover", node->path);
+
+        // The imports of a cached module are its dependencies, including the standard library base
+        auto interface = cache.LoadInterface(node->key);
+        if (interface.has_value() && cache.IsUpToDate(*interface, graph->getTarget(), graph->getOptimizationLevel(), graph->getLTO())) {
+            std::vector<ModuleNode *> nodes;
+            for (const auto &dependency: interface->getDependencies())
+                nodes.push_back(graph->Load(dependency.path, dependency.alias));
+
+            node->imports = discover(nodes);
+            continue;
+        }
+
+        // The lexer is only kept until the paths of the imports are read, the module is scanned again when compiled
+        llvm::TimeTraceScope scan_scope("Scan imports", node->path);
+        Lexer lexer(node->sourceMgr);
+        auto imports = std::vector<Import *>();
+        try {
+            lexer.ScanAll();
+            imports = Parser(lexer).ParseImports();
+        } catch (const LesmaError &err) {
+            if (!err.getSpan().isValid())
+                print(ERROR, err.what());
+            else
+                showInline(node->sourceMgr.get(), 1, err.getSpan(), err.what(), node->path, true);
+
+            throw CodegenError({}, "Unable to import {} due to errors", node->path);
+        }
+
+        node->imports = getImports(node->path, imports);
+        for (auto import: imports)
+            delete import;
+    }
+
+    // Check for circular imports, which can't be compiled in any order
+    std::map<ModuleNode *, int> state;
+    std::function<void(ModuleNode *)> visit = [&](ModuleNode *node) {
+        state[node] = 1;
+        for (auto import: node->imports) {
+            if (state[import] == 1)
+                throw CodegenError({}, "Circular import of {} from {}", import->path, node->path);
+            if (state[import] == 0)
+                visit(import);
+        }
+        state[node] = 2;
+    };
+
+    for (auto node: graph->getNodes()) {
+        if (state[node] == 0)
+            visit(node);
+    }
+}
+
+/**
+ * Compile the discovered modules on a thread pool, each module as soon as all its imports are compiled
+ *
+ * @param graph Graph of the current compilation
+ * @param jit Whether the modules will be executed by the JIT
+ */
+void Driver::CompileModules(const std::shared_ptr<ModuleGraph> &graph, bool jit) {
+    std::mutex mutex;
+    std::map<ModuleNode *, size_t> pending;
+    std::map<ModuleNode *, std::vector<ModuleNode *>> importers;
+    std::vector<ModuleNode *> failed;
+
+    for (auto node: graph->getNodes()) {
+        pending[node] = node->imports.size();
+        for (auto import: node->imports)
+            importers[import].push_back(node);
+    }
+
+    bool trace = llvm::timeTraceProfilerEnabled();
+    llvm::ThreadPool pool(llvm::hardware_concurrency(graph->getThreads()));
+    std::function<void(ModuleNode *)> schedule = [&](ModuleNode *node) {
+        pool.async([&, node] {
+            TimeTraceThread trace_thread(trace);
+            try {
+                Codegen::CompileNode(graph, *node, jit);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failed.push_back(node);
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto importer: importers[node]) {
+                if (--pending[importer] == 0)
+                    schedule(importer);
+            }
+        });
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto [node, count]: pending) {
+            if (count == 0)
+                schedule(node);
+        }
+    }
+    pool.wait();
+
+    if (!failed.empty())
+        throw CodegenError({}, "Unable to import {} due to errors", failed.front()->path);
+}
+
+/**
+ * Prepare a long-running process to compile many programs, by initializing the targets and keeping the
+ * standard library compiled in memory, for the default options of run and compile
+ */
+void Driver::Warm() {
+    Codegen::InitializeTargets();
+    ModuleCache::KeepInMemory();
+
+    for (bool jit: {true, false}) {
+        auto graph = CreateModuleGraph(Options{SourceType::STRING, ""}, jit);
+        try {
+            Codegen::CompileNode(graph, *graph->Load(getStdDir() + "base.les", ""), jit);
+        } catch (const LesmaError &) {
+            // The error was already shown, and will be shown again to the requests importing it
+        }
+    }
+}
+
+/**
+ * Read an input of the REPL, statements opening a block continue until an empty line
+ *
+ * @param input Input read
+ * @return Whether an input was read, or the input ended
+ */
+bool Driver::ReadInput(std::string &input) {
+    static const std::regex block_regex(R"(^(export\s+)?(def|class|enum|if|while)\b)");
+    static const std::regex extern_regex(R"(^(export\s+)?def\s+extern\b)");
+
+    input.clear();
+    print(">>> ");
+    std::fflush(stdout);
+
+    std::string line;
+    if (!std::getline(std::cin, line))
+        return false;
+    input += line + "\n";
+
+    bool block = std::regex_search(line, block_regex) && !std::regex_search(line, extern_regex);
+    while (block) {
+        print("... ");
+        std::fflush(stdout);
+        if (!std::getline(std::cin, line) || line.empty())
+            break;
+        input += line + "\n";
+    }
+
+    return true;
+}
+
+/**
+ * Run an interactive session, where every input is compiled and added to the same JIT and run at once
+ *
+ * @param options Options of the session
+ * @return Exit code
+ */
+int Driver::Repl(std::unique_ptr<lesma::Options> options) {
+    try {
+        Session session(*options);
+
+        std::string input;
+        while (ReadInput(input)) {
+            try {
+                session.Evaluate(input, "<repl>");
+            } catch (const LesmaError &) {
+                // The error was already shown, the session continues with the next input
+            }
+        }
+
+        print("\n");
+        return 0;
+    } catch (const LesmaError &err) {
+        print(ERROR, "{}\n", err.what());
+        return err.exit_code;
+    }
+}
+
 int Driver::Run(std::unique_ptr<lesma::Options> options) {
     return BaseCompile(std::move(options), true);
 }
@@ -105,3 +407,63 @@ int Driver::Run(std::unique_ptr<lesma::Options> options) {
 int Driver::Compile(std::unique_ptr<lesma::Options> options) {
     return BaseCompile(std::move(options), false);
 }
+
+/**
+ * Compile many programs in parallel, sharing the initialized targets and the compiled imports
+ *
+ * @param options Options of each program
+ * @param jobs Number of programs compiled in parallel, 0 for the number of cores
+ * @return Exit code of the first program which failed, or 0
+ */
+int Driver::CompileAll(std::vector<std::unique_ptr<lesma::Options>> options, unsigned jobs) {
+    Codegen::InitializeTargets();
+    ModuleCache::KeepInMemory();
+
+    // The time trace, the memory report and the timer and debug output are shared by the whole process,
+    // the programs compiled at the same time can't be told apart
+    if (options.size() > 1) {
+        bool traced = false, reported = false, timed = false, debugged = false;
+        for (auto &program_options: options) {
+            traced |= !program_options->time_trace.empty();
+            reported |= program_options->mem_report;
+            timed |= program_options->timer;
+            debugged |= program_options->debug != NONE;
+            program_options->time_trace.clear();
+            program_options->mem_report = false;
+            program_options->timer = false;
+            program_options->debug = NONE;
+        }
+
+        if (traced)
+            print(WARNING, "Time trace is only written when compiling a single file\n");
+        if (reported)
+            print(WARNING, "Memory report is only shown when compiling a single file\n");
+        if (timed)
+            print(WARNING, "Timer is only shown when compiling a single file\n");
+        if (debugged)
+            print(WARNING, "Debug output is only shown when compiling a single file\n");
+    }
+
+    // Every program is compiled on its share of the cores, its own thread pools would otherwise use all of them
+    auto strategy = llvm::hardware_concurrency(jobs);
+    auto programs = std::max<unsigned>(1, std::min<size_t>(strategy.compute_thread_count(), options.size()));
+    auto threads = std::max(1u, llvm::hardware_concurrency().compute_thread_count() / programs);
+    for (auto &program_options: options)
+        program_options->threads = threads;
+
+    std::vector<int> exit_codes(options.size());
+    llvm::ThreadPool pool(strategy);
+    for (size_t i = 0; i < options.size(); i++) {
+        pool.async([&, i] {
+            exit_codes[i] = BaseCompile(std::move(options[i]), false);
+        });
+    }
+    pool.wait();
+
+    for (auto exit_code: exit_codes) {
+        if (exit_code != 0)
+            return exit_code;
+    }
+
+    return 0;
+}
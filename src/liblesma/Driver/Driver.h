@@ -1,5 +1,6 @@
 #pragma once
 
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -29,14 +30,42 @@ namespace lesma {
         Debug debug = NONE;
         std::string output_filename = "output";
         bool timer = false;
+        unsigned partitions = 1;
+        bool lazy = false;
+        // Defaults to O3, or to a fast pipeline for the JIT
+        std::optional<OptimizationLevel> optimization;
+        // Target CPU and features, native compiles for the host
+        std::string cpu = "generic";
+        std::string features;
+        // Features the functions of the main module are also compiled for, the variant is picked when the program starts
+        std::vector<std::string> multiversion;
+        LTOKind lto = LTOKind::None;
+        // Reuse the objects of the functions which didn't change since the previous build
+        bool incremental = false;
+        // Path of the Chrome trace of the compilation, and minimum duration of its events in microseconds
+        std::string time_trace;
+        unsigned time_trace_granularity = 500;
+        // Report the memory used per phase and per category of objects
+        bool mem_report = false;
+        // Threads the imports, partitions and ThinLTO backends are compiled on, 0 for every core
+        unsigned threads = 0;
+        // Directory of the module, object and linker caches, defaults to ~/.lesma/cache
+        std::string cache_dir = getCacheDir();
     };
 
     class Driver {
     private:
         static int BaseCompile(std::unique_ptr<lesma::Options> options, bool jit);
+        static void DiscoverModules(const std::shared_ptr<ModuleGraph> &graph, const std::string &filename, Compound *ast);
+        static void CompileModules(const std::shared_ptr<ModuleGraph> &graph, bool jit);
+        static bool ReadInput(std::string &input);
 
     public:
         static int Run(std::unique_ptr<lesma::Options> options);
+        static int Repl(std::unique_ptr<lesma::Options> options);
         static int Compile(std::unique_ptr<lesma::Options> options);
+        static int CompileAll(std::vector<std::unique_ptr<lesma::Options>> options, unsigned jobs);
+        static void Warm();
+        static std::shared_ptr<ModuleGraph> CreateModuleGraph(const Options &options, bool jit);
     };
 }// namespace lesma
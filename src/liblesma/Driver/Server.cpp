@@ -0,0 +1,288 @@
+#include "Server.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "liblesma/Common/Utils.h"
+
+using namespace lesma;
+
+// A request is the size of its payload, sent along with the standard streams of the client, followed by the payload:
+// the working directory and the arguments of the client, each terminated by a null character.
+// The server answers with the exit code of the request once it's done.
+static constexpr int STREAMS = 3;
+static constexpr uint32_t MAX_PAYLOAD = 1 << 20;
+
+// macOS doesn't have the flag, its sockets don't raise SIGPIPE once prepared
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/**
+ * Prepare a socket or a received stream, which isn't inherited by the programs run by requests. The flags setting it
+ * atomically on creation are specific to Linux.
+ *
+ * @param fd File descriptor, or a negative value if it couldn't be created
+ * @return File descriptor
+ */
+static int prepareDescriptor(int fd) {
+    if (fd < 0)
+        return fd;
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    int enabled = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#endif
+    return fd;
+}
+
+static sockaddr_un getAddress(const std::string &socket_path) {
+    sockaddr_un address{};
+    if (socket_path.size() >= sizeof(address.sun_path))
+        throw ServerError({}, "Socket path is too long: {}", socket_path);
+
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    return address;
+}
+
+static void sendAll(int fd, const void *data, size_t size) {
+    auto bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        auto result = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result < 0)
+            throw ServerError({}, "Unable to send request: {}", std::strerror(errno));
+
+        bytes += result;
+        size -= result;
+    }
+}
+
+static bool receiveAll(int fd, void *data, size_t size) {
+    auto bytes = static_cast<char *>(data);
+    while (size > 0) {
+        auto result = recv(fd, bytes, size, 0);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+
+        bytes += result;
+        size -= result;
+    }
+
+    return true;
+}
+
+std::string Server::getDefaultSocket() {
+    return getCacheDir() + "server.sock";
+}
+
+/**
+ * Listen for requests until the server is killed
+ *
+ * @param socket_path Path of the Unix socket
+ * @param handler Function handling the arguments of a request, in a process with the streams and working directory of the client
+ * @return Exit code, if the server couldn't listen
+ */
+int Server::Serve(const std::string &socket_path, const Handler &handler) {
+    try {
+        auto address = getAddress(socket_path);
+        llvm::sys::fs::create_directories(llvm::sys::path::parent_path(socket_path));
+
+        int listener = prepareDescriptor(socket(AF_UNIX, SOCK_STREAM, 0));
+        if (listener < 0)
+            throw ServerError({}, "Unable to create socket: {}", std::strerror(errno));
+
+        // Replace the socket of a server that didn't shut down cleanly, but not the one of a running server
+        if (connect(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0)
+            throw ServerError({}, "A server is already listening on {}", socket_path);
+        close(listener);
+        unlink(socket_path.c_str());
+
+        listener = prepareDescriptor(socket(AF_UNIX, SOCK_STREAM, 0));
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0)
+            throw ServerError({}, "Unable to listen on {}: {}", socket_path, std::strerror(errno));
+
+        // Requests report their exit code by themselves, and are reaped by the kernel
+        signal(SIGCHLD, SIG_IGN);
+        signal(SIGPIPE, SIG_IGN);
+        print(SUCCESS, "Listening on {}\n", socket_path);
+
+        while (true) {
+            int connection = prepareDescriptor(accept(listener, nullptr, nullptr));
+            if (connection < 0 && (errno == EINTR || errno == ECONNABORTED))
+                continue;
+            if (connection < 0)
+                throw ServerError({}, "Unable to accept requests on {}: {}", socket_path, std::strerror(errno));
+
+            HandleConnection(listener, connection, handler);
+        }
+    } catch (const ServerError &err) {
+        print(ERROR, "{}\n", err.what());
+        return err.exit_code;
+    }
+}
+
+/**
+ * Handle a request in a forked process, which runs the handler in another process to report its exit code,
+ * even if the handler exits or crashes
+ *
+ * @param listener Socket of the server
+ * @param connection Connection of the client
+ * @param handler Function handling the arguments of the request
+ */
+void Server::HandleConnection(int listener, int connection, const Handler &handler) {
+    // Output buffered by the server would be written again by the request
+    fflush(nullptr);
+
+    auto pid = fork();
+    if (pid != 0) {
+        if (pid < 0)
+            print(ERROR, "Unable to handle request: {}\n", std::strerror(errno));
+        close(connection);
+        return;
+    }
+
+    close(listener);
+    signal(SIGCHLD, SIG_DFL);
+
+    try {
+        uint32_t size = 0;
+        int streams[STREAMS] = {-1, -1, -1};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(streams))];
+        iovec header{&size, sizeof(size)};
+        msghdr message{};
+        message.msg_iov = &header;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        if (recvmsg(connection, &message, 0) != sizeof(size) || size > MAX_PAYLOAD)
+            throw ServerError({}, "Invalid request");
+
+        for (auto cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(streams)))
+                std::memcpy(streams, CMSG_DATA(cmsg), sizeof(streams));
+        }
+        for (auto fd: streams)
+            prepareDescriptor(fd);
+
+        std::string payload(size, '\0');
+        if (streams[0] < 0 || !receiveAll(connection, payload.data(), size) || payload.empty() || payload.back() != '\0')
+            throw ServerError({}, "Invalid request");
+
+        std::vector<std::string> args;
+        for (size_t start = 0, end; start < payload.size(); start = end + 1) {
+            end = payload.find('\0', start);
+            args.push_back(payload.substr(start, end - start));
+        }
+        auto cwd = args.front();
+        args.erase(args.begin());
+
+        fflush(nullptr);
+        auto worker = fork();
+        if (worker == 0) {
+            close(connection);
+            signal(SIGPIPE, SIG_DFL);
+            for (int fd = 0; fd < STREAMS; fd++) {
+                dup2(streams[fd], fd);
+                close(streams[fd]);
+            }
+
+            if (chdir(cwd.c_str()) < 0) {
+                print(ERROR, "Unable to change directory to {}: {}\n", cwd, std::strerror(errno));
+                exit(EX_OSERR);
+            }
+
+            // Exiting flushes the output of the request
+            exit(handler(args));
+        }
+
+        for (auto fd: streams)
+            close(fd);
+
+        int status = 0;
+        if (worker < 0 || waitpid(worker, &status, 0) < 0)
+            throw ServerError({}, "Unable to handle request: {}", std::strerror(errno));
+
+        int32_t exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        sendAll(connection, &exit_code, sizeof(exit_code));
+    } catch (const ServerError &err) {
+        print(ERROR, "{}\n", err.what());
+    }
+
+    _exit(0);
+}
+
+/**
+ * Forward a command to a server, which compiles or runs it with the streams and working directory of this process
+ *
+ * @param socket_path Path of the Unix socket of the server
+ * @param args Arguments of the command
+ * @return Exit code of the command, or nothing if no server is listening
+ */
+std::optional<int> Server::Forward(const std::string &socket_path, const std::vector<std::string> &args) {
+    int connection = -1;
+    try {
+        auto address = getAddress(socket_path);
+        connection = prepareDescriptor(socket(AF_UNIX, SOCK_STREAM, 0));
+        if (connection < 0 || connect(connection, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+            if (connection >= 0)
+                close(connection);
+            return std::nullopt;
+        }
+
+        std::string payload = std::filesystem::current_path().string();
+        payload.push_back('\0');
+        for (const auto &arg: args) {
+            payload += arg;
+            payload.push_back('\0');
+        }
+
+        uint32_t size = payload.size();
+        int streams[STREAMS] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(streams))] = {};
+        iovec header{&size, sizeof(size)};
+        msghdr message{};
+        message.msg_iov = &header;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        auto cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(streams));
+        std::memcpy(CMSG_DATA(cmsg), streams, sizeof(streams));
+
+        if (sendmsg(connection, &message, MSG_NOSIGNAL) != sizeof(size))
+            throw ServerError({}, "Unable to send request: {}", std::strerror(errno));
+        sendAll(connection, payload.data(), payload.size());
+
+        int32_t exit_code = 0;
+        if (!receiveAll(connection, &exit_code, sizeof(exit_code)))
+            throw ServerError({}, "Lost the connection to the server");
+
+        close(connection);
+        return exit_code;
+    } catch (const ServerError &err) {
+        if (connection >= 0)
+            close(connection);
+
+        print(ERROR, "{}\n", err.what());
+        return err.exit_code;
+    }
+}
\ No newline at end of file
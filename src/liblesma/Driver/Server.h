@@ -0,0 +1,35 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <sysexits.h>
+#include <vector>
+
+#include "liblesma/Common/LesmaError.h"
+
+namespace lesma {
+    class ServerError : public LesmaErrorWithExitCode<EX_OSERR> {
+    public:
+        using LesmaErrorWithExitCode<EX_OSERR>::LesmaErrorWithExitCode;
+    };
+
+    /**
+     * Compile server listening on a Unix socket. Clients send their arguments, working directory and standard streams,
+     * and every request is handled in a process forked from the server, so it starts with the targets initialized and
+     * the standard library already compiled, and a crashing program can't take the server down.
+     * Only the modules compiled by the server before it forks are kept in memory for every request. The modules
+     * compiled by a request are lost with its process, later requests read them from the disk cache.
+     */
+    class Server {
+    public:
+        using Handler = std::function<int(const std::vector<std::string> &args)>;
+
+        static std::string getDefaultSocket();
+        static int Serve(const std::string &socket_path, const Handler &handler);
+        static std::optional<int> Forward(const std::string &socket_path, const std::vector<std::string> &args);
+
+    private:
+        static void HandleConnection(int listener, int connection, const Handler &handler);
+    };
+}// namespace lesma
\ No newline at end of file
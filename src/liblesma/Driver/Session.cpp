@@ -0,0 +1,57 @@
+#include "Session.h"
+
+using namespace lesma;
+
+/**
+ * Create a session, compiling the standard library and creating the JIT
+ *
+ * @param options Optimization level and target of the session
+ */
+Session::Session(const Options &options) {
+    auto graph = Driver::CreateModuleGraph(options, true);
+    codegen = std::make_unique<Codegen>(nullptr, std::make_shared<llvm::SourceMgr>(), "", graph, true, true);
+    codegen->PrepareREPL();
+}
+
+/**
+ * Compile source code and run its top-level statements, its functions and variables are kept in the session
+ *
+ * @param source Source code
+ * @param name Name of the source shown in errors
+ * @return Result of the top-level statements
+ */
+int Session::Evaluate(const std::string &source, const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto srcMgr = std::make_shared<llvm::SourceMgr>();
+    srcMgr->AddNewSourceBuffer(llvm::MemoryBuffer::getMemBufferCopy(source, name), llvm::SMLoc());
+
+    try {
+        auto source_lexer = std::make_unique<Lexer>(srcMgr);
+        auto parser = std::make_shared<Parser>(*source_lexer);
+        parser->Parse();
+
+        // The code generator keeps the parser, the previous lexer is released once its parser is replaced
+        std::swap(lexer, source_lexer);
+        return codegen->Evaluate(parser, srcMgr);
+    } catch (const LesmaError &err) {
+        if (!err.getSpan().isValid())
+            print(ERROR, "{}\n", err.what());
+        else
+            showInline(srcMgr.get(), 1, err.getSpan(), err.what(), name, true);
+
+        throw;
+    }
+}
+
+/**
+ * Get a function defined by the evaluated sources or imported by them
+ *
+ * @param name Name of the function
+ * @return Address of the function, or nullptr if there's no such function
+ */
+void *Session::Lookup(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return codegen->LookupFunction(name);
+}
\ No newline at end of file
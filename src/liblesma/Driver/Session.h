@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "liblesma/Backend/Codegen.h"
+#include "liblesma/Driver/Driver.h"
+
+namespace lesma {
+    /**
+     * Embeddable compilation session. The targets, the JIT and the standard library are set up once when it's created,
+     * then every source evaluated is compiled to its own module and added to the same JIT, and the functions it defines
+     * can be looked up and called from C++. Errors are shown and thrown as LesmaError.
+     *
+     * @code
+     * Session session;
+     * session.Evaluate("def add(x: int, y: int) -> int\n    return x + y\n");
+     * auto add = session.Lookup<int64_t(int64_t, int64_t)>("add");
+     * @endcode
+     */
+    class Session {
+    public:
+        explicit Session(const Options &options = Options{SourceType::STRING, ""});
+
+        int Evaluate(const std::string &source, const std::string &name = "<input>");
+        void *Lookup(const std::string &name);
+
+        template<typename T>
+        T *Lookup(const std::string &name) {
+            return reinterpret_cast<T *>(Lookup(name));
+        }
+
+    private:
+        std::mutex mutex;
+        // Lexer of the last source, it outlives the code generator which keeps the parser reading its tokens
+        std::unique_ptr<Lexer> lexer;
+        std::unique_ptr<Codegen> codegen;
+    };
+}// namespace lesma
\ No newline at end of file
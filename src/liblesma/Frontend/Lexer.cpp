@@ -3,153 +3,193 @@
 using namespace lesma;
 
 void Lexer::ScanAll() {
-    while (tokens.empty() || tokens.back()->type != TokenType::EOF_TOKEN)
-        tokens.push_back(ScanOne(false));
+    keep_all = true;
+    ScanUntil(std::numeric_limits<size_t>::max() - 1);
 }
 
-Token *Lexer::ScanOne(bool continuation) {
-    if (IsAtEnd())
-        return new Token{TokenType::EOF_TOKEN, "EOF", llvm::SMRange{begin_loc, loc}};
-    ResetTokenBeg();
-    char c = Advance();
-
-    switch (c) {
-        case '(':
-            level_++;
-            return AddToken(TokenType::LEFT_PAREN);
-        case ')':
-            level_--;
-            return AddToken(TokenType::RIGHT_PAREN);
-        case '[':
-            level_++;
-            return AddToken(TokenType::LEFT_SQUARE);
-        case ']':
-            level_--;
-            return AddToken(TokenType::RIGHT_SQUARE);
-        case '{':
-            level_++;
-            return AddToken(TokenType::LEFT_BRACE);
-        case '}':
-            level_--;
-            return AddToken(TokenType::RIGHT_BRACE);
-        case ':':
-            return AddToken(TokenType::COLON);
-        case ',':
-            return AddToken(TokenType::COMMA);
-        case '.': {
-            if (MatchAndAdvance(('.'))) {
-                if (MatchAndAdvance('.'))
-                    return AddToken(TokenType::ELLIPSIS);
-                else
-                    return AddToken(TokenType::RANGE);
-            } else
-                return AddToken(TokenType::DOT);
-        }
-        case '-': {
-            if (MatchAndAdvance('>'))
-                return AddToken(TokenType::ARROW);
-            else if (MatchAndAdvance('='))
-                return AddToken(TokenType::MINUS_EQUAL);
+/**
+ * Scan until the token at an index is final. A token can still be merged with the next one into a multi-word keyword,
+ * so it's final once another token follows it, or once the source is scanned.
+ *
+ * @param index Index of the token
+ */
+void Lexer::ScanUntil(size_t index) {
+    while (!scanned && tokens.size() <= index + 1) {
+        ScanOne(false);
+        scanned = tokens.getLastType() == TokenType::EOF_TOKEN;
+    }
 
-            return AddToken(TokenType::MINUS);
-        }
-        case '+': {
-            if (MatchAndAdvance('='))
-                return AddToken(TokenType::PLUS_EQUAL);
+    // The token buffer is counted as a whole once scanned, it's freed with the lexer
+    if (scanned && reported_tokens != tokens.size() && MemoryReport::isEnabled()) {
+        MemoryReport::Allocate(MemoryCategory::Tokens, tokens.getMemorySize() - reported_bytes, tokens.size() - reported_tokens);
+        reported_bytes = tokens.getMemorySize();
+        reported_tokens = tokens.size();
+    }
+}
 
-            return AddToken(TokenType::PLUS);
-        }
-        case ';':
-            return AddToken(TokenType::SEMICOLON);
-        case '*': {
-            if (MatchAndAdvance('='))
-                return AddToken(TokenType::STAR_EQUAL);
-            return AddToken(TokenType::STAR);
-        }
-        case '&':
-            return AddToken(TokenType::AMPERSAND);
-        case '!':
-            return AddToken(MatchAndAdvance('=') ? TokenType::BANG_EQUAL : TokenType::BANG);
-        case '=': {
-            if (MatchAndAdvance('='))
-                return AddToken(TokenType::EQUAL_EQUAL);
-            else if (MatchAndAdvance('>'))
-                return AddToken(TokenType::FAT_ARROW);
-
-            return AddToken(TokenType::EQUAL);
-        }
-        case '<':
-            return AddToken(MatchAndAdvance('=') ? TokenType::LESS_EQUAL : TokenType::LESS);
-        case '>':
-            return AddToken(MatchAndAdvance('=') ? TokenType::GREATER_EQUAL : TokenType::GREATER);
-        case '/': {
-            if (MatchAndAdvance('='))
-                return AddToken(TokenType::SLASH_EQUAL);
-            return AddToken(TokenType::SLASH);
-        }
-        case '%': {
-            if (MatchAndAdvance('='))
-                return AddToken(TokenType::MOD_EQUAL);
-            return AddToken(TokenType::MOD);
-        }
-        case '^': {
-            if (MatchAndAdvance('='))
-                return AddToken(TokenType::POWER_EQUAL);
-            return AddToken(TokenType::POWER);
-        }
-        case '#': {
-            // A comment goes until the end of the line.
-            while (Peek() != '\n' && !IsAtEnd()) Advance();
-            return ScanOne(continuation);
-        }
-        case '\\':
-            c = Advance();
-            continuation = true;
-
-            while (true) {
-                if (c == ' ' || c == '\r' || c == '\t')
-                    c = Advance();
-                else if (c == '#') {
-                    while (Peek() != '\n' && !IsAtEnd()) Advance();
-                    c = Advance();
-                    break;
+/**
+ * Release the tokens before an index, unless the whole source was scanned to keep them
+ *
+ * @param index Index of the first token still read
+ */
+void Lexer::Release(size_t index) {
+    if (!keep_all)
+        tokens.Release(index);
+}
+
+void Lexer::ScanOne(bool continuation) {
+    // Whitespace, comments, line continuations and newlines are skipped by scanning the next character
+    while (true) {
+        if (IsAtEnd())
+            return tokens.Add(TokenType::EOF_TOKEN, {begin_loc, loc});
+        ResetTokenBeg();
+        char c = Advance();
+
+        switch (c) {
+            case '(':
+                level_++;
+                return AddToken(TokenType::LEFT_PAREN);
+            case ')':
+                level_--;
+                return AddToken(TokenType::RIGHT_PAREN);
+            case '[':
+                level_++;
+                return AddToken(TokenType::LEFT_SQUARE);
+            case ']':
+                level_--;
+                return AddToken(TokenType::RIGHT_SQUARE);
+            case '{':
+                level_++;
+                return AddToken(TokenType::LEFT_BRACE);
+            case '}':
+                level_--;
+                return AddToken(TokenType::RIGHT_BRACE);
+            case ':':
+                return AddToken(TokenType::COLON);
+            case ',':
+                return AddToken(TokenType::COMMA);
+            case '.': {
+                if (MatchAndAdvance(('.'))) {
+                    if (MatchAndAdvance('.'))
+                        return AddToken(TokenType::ELLIPSIS);
+                    else
+                        return AddToken(TokenType::RANGE);
                 } else
-                    break;
+                    return AddToken(TokenType::DOT);
             }
+            case '-': {
+                if (MatchAndAdvance('>'))
+                    return AddToken(TokenType::ARROW);
+                else if (MatchAndAdvance('='))
+                    return AddToken(TokenType::MINUS_EQUAL);
 
-            if (c != '\n')
-                Error(fmt::format("Newline expected after line continuation, found {}", c));
-
-            line++;
-            col = 1;
+                return AddToken(TokenType::MINUS);
+            }
+            case '+': {
+                if (MatchAndAdvance('='))
+                    return AddToken(TokenType::PLUS_EQUAL);
 
-            return ScanOne(continuation);
-        case ' ':
-        case '\r':
-        case '\t':
-            HandleWhitespace(c);
-            if (col == 2)
-                HandleIndentation(false);
-            return ScanOne(continuation);
-        case '\n':
-            line++;
-            col = 1;
-            if (!continuation && level_ == 0)
-                tokens.push_back(AddToken(new Token{TokenType::NEWLINE, "NEWLINE", llvm::SMRange{begin_loc, loc}}));
-            HandleIndentation(continuation);
-            return ScanOne(false);
-        case '"':
-            return AddStringToken();
-        default:
-            if (IsDigit(c))
-                return AddNumToken();
-            else if (IsAlpha(c))
-                return AddIdentifierToken();
-            else
-                Error(fmt::format("Unexpected character: {}", c));
+                return AddToken(TokenType::PLUS);
+            }
+            case ';':
+                return AddToken(TokenType::SEMICOLON);
+            case '*': {
+                if (MatchAndAdvance('='))
+                    return AddToken(TokenType::STAR_EQUAL);
+                return AddToken(TokenType::STAR);
+            }
+            case '&':
+                return AddToken(TokenType::AMPERSAND);
+            case '!':
+                return AddToken(MatchAndAdvance('=') ? TokenType::BANG_EQUAL : TokenType::BANG);
+            case '=': {
+                if (MatchAndAdvance('='))
+                    return AddToken(TokenType::EQUAL_EQUAL);
+                else if (MatchAndAdvance('>'))
+                    return AddToken(TokenType::FAT_ARROW);
+
+                return AddToken(TokenType::EQUAL);
+            }
+            case '<':
+                return AddToken(MatchAndAdvance('=') ? TokenType::LESS_EQUAL : TokenType::LESS);
+            case '>':
+                return AddToken(MatchAndAdvance('=') ? TokenType::GREATER_EQUAL : TokenType::GREATER);
+            case '/': {
+                if (MatchAndAdvance('='))
+                    return AddToken(TokenType::SLASH_EQUAL);
+                return AddToken(TokenType::SLASH);
+            }
+            case '%': {
+                if (MatchAndAdvance('='))
+                    return AddToken(TokenType::MOD_EQUAL);
+                return AddToken(TokenType::MOD);
+            }
+            case '^': {
+                if (MatchAndAdvance('='))
+                    return AddToken(TokenType::POWER_EQUAL);
+                return AddToken(TokenType::POWER);
+            }
+            case '#': {
+                // A comment goes until the end of the line.
+                AdvanceTo(Scan::FindNewline(curPtr, curBuffer->getBufferEnd()));
+                continue;
+            }
+            case '\\':
+                c = Advance();
+                continuation = true;
+
+                while (true) {
+                    if (c == ' ' || c == '\r' || c == '\t')
+                        c = Advance();
+                    else if (c == '#') {
+                        AdvanceTo(Scan::FindNewline(curPtr, curBuffer->getBufferEnd()));
+                        c = Advance();
+                        break;
+                    } else
+                        break;
+                }
+
+                if (c != '\n')
+                    Error(fmt::format("Newline expected after line continuation, found {}", c));
+
+                line++;
+                col = 1;
+
+                continue;
+            case ' ':
+            case '\r':
+            case '\t':
+                HandleWhitespace(c);
+                if (col == 2)
+                    HandleIndentation(false);
+                else {
+                    // The rest of the run is the same character, which is checked and counted as a whole
+                    auto count = Scan::SkipByte(curPtr, curBuffer->getBufferEnd(), c) - curPtr;
+                    AdvanceTo(curPtr + count);
+                    if (c == '\t')
+                        col += 7 * count;
+                }
+                continue;
+            case '\n':
+                line++;
+                col = 1;
+                if (!continuation && level_ == 0)
+                    AddToken(TokenType::NEWLINE);
+                HandleIndentation(continuation);
+                continuation = false;
+                continue;
+            case '"':
+                return AddStringToken();
+            default:
+                if (IsDigit(c))
+                    return AddNumToken();
+                else if (IsAlpha(c))
+                    return AddIdentifierToken();
+                else
+                    Error(fmt::format("Unexpected character: {}", c));
+        }
+        Error("Unknown error");
     }
-    Error("Unknown error");
-    return {};
 }
 
 void Lexer::HandleWhitespace(char c) {
@@ -189,8 +229,8 @@ bool Lexer::HandleIndentation(bool continuation) {
     if (continuation || level_ != 0 || c == '#' || c == '\n' || c == '\r') {
         if (c == '#' || c == '\n') {
             // If this line is a commented line or an empty line, don't emit NewLine
-            if (!tokens.empty() && tokens.back()->type == TokenType::NEWLINE) {
-                tokens.pop_back();
+            if (!tokens.empty() && tokens.getLastType() == TokenType::NEWLINE) {
+                tokens.PopBack();
             }
         }
         return true;
@@ -232,21 +272,15 @@ bool Lexer::HandleIndentation(bool continuation) {
     }
 
     while (changes != 0) {
-        tokens.push_back(AddToken(new Token{changes > 0 ? TokenType::INDENT : TokenType::DEDENT, changes > 0 ? "INDENT" : "DEDENT", llvm::SMRange{begin_loc, loc}}));
+        AddToken(changes > 0 ? TokenType::INDENT : TokenType::DEDENT);
         changes += changes > 0 ? -1 : 1;
     }
     return true;
 }
 
-Token *Lexer::AddToken(TokenType type) {
-    auto ret = new Token(type, std::string(begin_loc.getPointer(), loc.getPointer()), llvm::SMRange{begin_loc, loc});
+void Lexer::AddToken(TokenType type) {
+    tokens.Add(type, {begin_loc, loc});
     ResetTokenBeg();
-    return ret;
-}
-
-Token *Lexer::AddToken(Token *tok) {
-    ResetTokenBeg();
-    return tok;
 }
 
 void Lexer::ResetTokenBeg() {
@@ -259,6 +293,13 @@ void Lexer::Fallback() {
     --col;
 }
 
+void Lexer::AdvanceTo(const char *ptr) {
+    auto count = ptr - curPtr;
+    curPtr = ptr;
+    loc = llvm::SMLoc::getFromPointer(loc.getPointer() + count);
+    col += count;
+}
+
 char Lexer::Advance() {
     auto ret = LastChar();
     curPtr++;
@@ -279,17 +320,22 @@ char Lexer::Peek(int offset) {
     return *(loc.getPointer() + offset);
 }
 
-Token *Lexer::AddStringToken() {
+void Lexer::AddStringToken() {
     std::string string;
 
-    while (Peek() != '"' && !IsAtEnd()) {
+    while (true) {
+        // Copy the body up to the closing quote, an escape sequence or a newline at once
+        auto stop = Scan::FindStringEnd(curPtr, curBuffer->getBufferEnd());
+        string.append(curPtr, stop);
+        AdvanceTo(stop);
+
+        if (Peek() == '"' || IsAtEnd())
+            break;
+
         // Should we allow newlines in strings? Probably not
         if (Peek() == '\n') {
             line++;
             col = 1;
-        }
-        // If it's not an escape sequence, proceed as usual
-        if (Peek() != '\\') {
             string.push_back(Advance());
             continue;
         }
@@ -337,20 +383,19 @@ Token *Lexer::AddStringToken() {
     // Skip the closing ".
     Advance();
 
-    auto ret = new Token(TokenType::STRING, string, llvm::SMRange{begin_loc, loc});
+    tokens.AddString({begin_loc, loc}, string);
     ResetTokenBeg();
-    return ret;
 }
 
-Token *Lexer::AddNumToken() {
-    while (IsDigit(Peek())) Advance();
+void Lexer::AddNumToken() {
+    AdvanceTo(Scan::SkipDigits(curPtr, curBuffer->getBufferEnd()));
 
     // Look for a fractional part.
     if ((Peek() == '.') && IsDigit(Peek(1))) {
         // Consume the "."
         Advance();
 
-        while (IsDigit(Peek())) Advance();
+        AdvanceTo(Scan::SkipDigits(curPtr, curBuffer->getBufferEnd()));
 
         return AddToken(TokenType::DOUBLE);
     } else {
@@ -358,26 +403,21 @@ Token *Lexer::AddNumToken() {
     }
 }
 
-Token *Lexer::GetLastToken() {
-    if (!tokens.empty())
-        return tokens.end()[-1];
-    else
-        return new Token{TokenType::EOF_TOKEN, "EOF", llvm::SMRange{begin_loc, loc}};
+TokenType Lexer::GetLastType() {
+    return tokens.empty() ? TokenType::EOF_TOKEN : tokens.getLastType();
 }
 
-Token *Lexer::AddIdentifierToken() {
-    while (IsAlphaNumeric(Peek())) Advance();
+void Lexer::AddIdentifierToken() {
+    AdvanceTo(Scan::SkipIdentifier(curPtr, curBuffer->getBufferEnd()));
 
-    auto tok = AddToken(Token::GetIdentifierType(std::string(begin_loc.getPointer(), loc.getPointer()), GetLastToken()));
+    auto identifier = llvm::StringRef(begin_loc.getPointer(), loc.getPointer() - begin_loc.getPointer());
+    auto type = Token::GetIdentifierType(identifier, GetLastType());
 
     // If it's a multi-word keyword, remove the last token
-    if (tok->type == TokenType::ELSE_IF || tok->type == TokenType::IS_NOT) {
-        auto t = tokens.back();
-        tokens.pop_back();
-        delete t;
-    }
+    if (type == TokenType::ELSE_IF || type == TokenType::IS_NOT)
+        tokens.PopBack();
 
-    return tok;
+    AddToken(type);
 }
 
 char Lexer::LastChar() { return *curPtr; }
@@ -1,52 +1,65 @@
 #pragma once
 
+#include <limits>
 #include <optional>
 #include <string>
 #include <sysexits.h>
 #include <vector>
 
 #include "liblesma/Common/LesmaError.h"
+#include "liblesma/Common/MemoryReport.h"
 #include "liblesma/Common/Utils.h"
+#include "liblesma/Frontend/Scan.h"
 #include "liblesma/Token/Token.h"
+#include "liblesma/Token/TokenBuffer.h"
 
 namespace lesma {
     class LexerError : public LesmaErrorWithExitCode<EX_DATAERR> {
         using LesmaErrorWithExitCode<EX_DATAERR>::LesmaErrorWithExitCode;
     };
 
+    /**
+     * Lexer of the last buffer of a source manager, its tokens live as long as the lexer. The source is either scanned
+     * all at once, keeping every token, or while a parser reads it, releasing the tokens the parser is done with.
+     */
     class Lexer {
     public:
         explicit Lexer(const std::shared_ptr<llvm::SourceMgr> &srcMgr)
             : curBuffer(srcMgr->getMemoryBuffer(srcMgr->getNumBuffers())),
-              curPtr(curBuffer->getBufferStart()), begin_loc(llvm::SMLoc::getFromPointer(curPtr)), loc(llvm::SMLoc::getFromPointer(curPtr)), srcMgr(srcMgr) {
+              curPtr(curBuffer->getBufferStart()), begin_loc(llvm::SMLoc::getFromPointer(curPtr)), loc(llvm::SMLoc::getFromPointer(curPtr)),
+              tokens(curBuffer->getBuffer()), srcMgr(srcMgr) {
+            // Tokens are stored with 32-bit offsets
+            if (curBuffer->getBufferSize() > std::numeric_limits<uint32_t>::max())
+                throw LexerError({}, "Source is too large: {} bytes", curBuffer->getBufferSize());
         }
         ~Lexer() {
-            for (auto t: tokens)
-                delete t;
-            tokens.clear();
+            if (reported_tokens != 0)
+                MemoryReport::Deallocate(MemoryCategory::Tokens, reported_bytes, reported_tokens);
         }
 
+        Lexer(const Lexer &) = delete;
+        Lexer &operator=(const Lexer &) = delete;
+
         void ScanAll();
-        Token *ScanOne(bool continuation = false);
-        std::vector<Token *> getTokens() { return tokens; };
+        void ScanUntil(size_t index);
+        void ScanOne(bool continuation = false);
+        void Release(size_t index);
+        const TokenBuffer &getTokens() const { return tokens; };
 
     private:
         bool MatchAndAdvance(char expected);
 
         char Peek(int offset = 0);
 
-        Token *AddStringToken();
+        void AddStringToken();
 
         static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
 
         static bool IsAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
 
-        static bool IsAlphaNumeric(char c) { return IsAlpha(c) || IsDigit(c); }
-
-        Token *AddNumToken();
+        void AddNumToken();
 
-        Token *AddToken(TokenType type);
-        Token *AddToken(Token *tok);
+        void AddToken(TokenType type);
 
         void Error(const std::string &msg) const;
 
@@ -55,9 +68,10 @@ namespace lesma {
         char LastChar();
 
         char Advance();
+        void AdvanceTo(const char *ptr);
 
-        Token *GetLastToken();
-        Token *AddIdentifierToken();
+        TokenType GetLastType();
+        void AddIdentifierToken();
 
         void HandleWhitespace(char c);
         bool HandleIndentation(bool continuation);
@@ -69,9 +83,14 @@ namespace lesma {
         unsigned int col = 1;
         llvm::SMLoc begin_loc;
         llvm::SMLoc loc;
-        std::vector<Token *> tokens;
+        TokenBuffer tokens;
         std::shared_ptr<llvm::SourceMgr> srcMgr;
 
+        bool scanned = false;
+        bool keep_all = false;
+        size_t reported_bytes = 0;
+        size_t reported_tokens = 0;
+
         std::optional<char> first_indent_char;
         int level_ = 0;
         int indent_ = 0;
@@ -41,26 +41,26 @@ bool Parser::CheckAny(unsigned long pos) {
     return true;
 }
 
-Token *Parser::Consume(TokenType type) {
+Token Parser::Consume(TokenType type) {
     return Consume(type, std::string{"Expected: "} + std::string{NAMEOF_ENUM(type)} +
-                                 ", found: " + std::string{NAMEOF_ENUM(Peek()->type)});
+                                 ", found: " + std::string{NAMEOF_ENUM(Peek().type)});
 }
 
-Token *Parser::Consume(TokenType type, const std::string &error_message) {
+Token Parser::Consume(TokenType type, const std::string &error_message) {
     if (Check(type)) return Advance();
     Error(Peek(), error_message);
-    return new Token{};
+    return {};
 }
 
-Token *Parser::ConsumeNewline() {
-    if (Check(TokenType::NEWLINE) || Peek()->type == TokenType::EOF_TOKEN)
+Token Parser::ConsumeNewline() {
+    if (Check(TokenType::NEWLINE) || Peek().type == TokenType::EOF_TOKEN)
         return Advance();
-    Error(Peek(), fmt::format("Expected: NEWLINE or EOF, found: {}", NAMEOF_ENUM(Peek()->type)));
-    return new Token{};
+    Error(Peek(), fmt::format("Expected: NEWLINE or EOF, found: {}", NAMEOF_ENUM(Peek().type)));
+    return {};
 }
 
-void Parser::Error(Token *token, const std::string &error_message) {
-    throw ParserError(token->span, "{}", error_message);
+void Parser::Error(const Token &token, const std::string &error_message) {
+    throw ParserError(token.span, "{}", error_message);
 }
 
 TypeExpr *Parser::ParseType() {
@@ -68,15 +68,15 @@ TypeExpr *Parser::ParseType() {
     if (Check(TokenType::STAR)) {
         Advance();
         auto element_type = ParseType();
-        return new TypeExpr({type->getStart(), element_type->getEnd()}, "*" + element_type->getName(), TokenType::PTR_TYPE, element_type);
+        return new TypeExpr({type.getStart(), element_type->getEnd()}, "*" + element_type->getName(), TokenType::PTR_TYPE, element_type);
     } else if (CheckAny<TokenType::INT_TYPE, TokenType::FLOAT_TYPE, TokenType::STRING_TYPE, TokenType::BOOL_TYPE,
                         TokenType::INT8_TYPE, TokenType::INT16_TYPE, TokenType::INT32_TYPE, TokenType::FLOAT32_TYPE, TokenType::VOID_TYPE>()) {
         Advance();
-        return new TypeExpr(type->span, type->lexeme, type->type);
+        return new TypeExpr(type.span, type.lexeme.str(), type.type);
     } else if (Check(TokenType::FUNC)) {
         std::vector<TypeExpr *> params;
         TypeExpr *ret;
-        std::string lexeme = type->lexeme + " (";
+        std::string lexeme = type.lexeme.str() + " (";
 
         Advance();
         Consume(TokenType::LEFT_PAREN);
@@ -94,17 +94,17 @@ TypeExpr *Parser::ParseType() {
             ret = ParseType();
             lexeme += " -> " + ret->getName();
         } else {
-            ret = new TypeExpr({params.back()->getEnd(), params.back()->getEnd()}, type->lexeme, type->type);
+            ret = new TypeExpr({params.back()->getEnd(), params.back()->getEnd()}, type.lexeme.str(), type.type);
         }
 
         // TODO: This should really be a pointer to a function type
-        return new TypeExpr({type->getStart(), ret->getEnd()}, lexeme, TokenType::FUNC_TYPE, params, ret);
+        return new TypeExpr({type.getStart(), ret->getEnd()}, lexeme, TokenType::FUNC_TYPE, params, ret);
     } else if (Check(TokenType::IDENTIFIER)) {
         Advance();
-        return new TypeExpr(type->span, type->lexeme, TokenType::CUSTOM_TYPE);
+        return new TypeExpr(type.span, type.lexeme.str(), TokenType::CUSTOM_TYPE);
     }
 
-    Error(type, fmt::format("Unknown type: {}", type->lexeme));
+    Error(type, fmt::format("Unknown type: {}", type.lexeme.str()));
 
     return nullptr;
 }
@@ -128,26 +128,26 @@ Expression *Parser::ParseFunctionCall() {
 
     auto paren = Consume(TokenType::RIGHT_PAREN);
 
-    return new FuncCall({token->getStart(), paren->span.End}, token->lexeme, params);
+    return new FuncCall({token.getStart(), paren.span.End}, token.lexeme.str(), params);
 }
 
 Expression *Parser::ParseTerm() {
-    switch (Peek()->type) {
+    switch (Peek().type) {
         case TokenType::STRING:
         case TokenType::INTEGER:
         case TokenType::DOUBLE:
         case TokenType::NIL: {
             auto token = Peek();
-            Consume(token->type);
-            return new Literal(token->span, token->lexeme, token->type);
+            Consume(token.type);
+            return new Literal(token.span, token.lexeme.str(), token.type);
         }
         case TokenType::IDENTIFIER: {
             if (CheckAny<TokenType::LEFT_PAREN>(1))
                 return ParseFunctionCall();
 
             auto token = Peek();
-            Consume(token->type);
-            return new Literal(token->span, token->lexeme, token->type);
+            Consume(token.type);
+            return new Literal(token.span, token.lexeme.str(), token.type);
         }
         case TokenType::LEFT_PAREN: {
             Consume(TokenType::LEFT_PAREN);
@@ -158,11 +158,11 @@ Expression *Parser::ParseTerm() {
         case TokenType::TRUE_:
         case TokenType::FALSE_: {
             auto token = Peek();
-            Consume(token->type);
-            return new Literal(token->span, token->lexeme, TokenType::BOOL);
+            Consume(token.type);
+            return new Literal(token.span, token.lexeme.str(), TokenType::BOOL);
         }
         default:
-            Error(Peek(), fmt::format("Unknown literal: {}", Peek()->lexeme));
+            Error(Peek(), fmt::format("Unknown literal: {}", Peek().lexeme.str()));
     }
 
     return nullptr;
@@ -174,7 +174,7 @@ Expression *Parser::ParseDot() {
     while (AdvanceIfMatchAny<TokenType::DOT>()) {
         auto op = Previous();
         auto expr = ParseTerm();
-        left = new DotOp({left->getStart(), expr->getEnd()}, left, op->type, expr);
+        left = new DotOp({left->getStart(), expr->getEnd()}, left, op.type, expr);
     }
 
     return left;
@@ -185,7 +185,7 @@ Expression *Parser::ParseUnary() {
     while (AdvanceIfMatchAny<TokenType::MINUS, TokenType::STAR, TokenType::AMPERSAND>()) {
         auto op = Previous();
         auto expr = ParseDot();
-        left = new UnaryOp({op->getStart(), expr->getEnd()}, op->type, expr);
+        left = new UnaryOp({op.getStart(), expr->getEnd()}, op.type, expr);
     }
 
     if (left == nullptr) {
@@ -208,7 +208,7 @@ Expression *Parser::ParseCast() {
 Expression *Parser::ParseMult() {
     auto left = ParsePower();
     while (AdvanceIfMatchAny<TokenType::STAR, TokenType::SLASH, TokenType::MOD>()) {
-        auto op = Previous()->type;
+        auto op = Previous().type;
         auto right = ParsePower();
         left = new BinaryOp({left->getStart(), right->getEnd()}, left, op, right);
     }
@@ -218,7 +218,7 @@ Expression *Parser::ParseMult() {
 Expression *Parser::ParsePower() {
     auto left = ParseCast();
     while (AdvanceIfMatchAny<TokenType::POWER>()) {
-        auto op = Previous()->type;
+        auto op = Previous().type;
         auto right = ParseCast();
         left = new BinaryOp({left->getStart(), right->getEnd()}, left, op, right);
     }
@@ -228,7 +228,7 @@ Expression *Parser::ParsePower() {
 Expression *Parser::ParseAdd() {
     auto left = ParseMult();
     while (AdvanceIfMatchAny<TokenType::PLUS, TokenType::MINUS>()) {
-        auto op = Previous()->type;
+        auto op = Previous().type;
         auto right = ParseMult();
         left = new BinaryOp({left->getStart(), right->getEnd()}, left, op, right);
     }
@@ -239,7 +239,7 @@ Expression *Parser::ParseCompare() {
     auto left = ParseAdd();
     while (AdvanceIfMatchAny<TokenType::EQUAL_EQUAL, TokenType::BANG_EQUAL, TokenType::LESS, TokenType::LESS_EQUAL,
                              TokenType::GREATER, TokenType::GREATER_EQUAL, TokenType::IS, TokenType::IS_NOT>()) {
-        auto op = Previous()->type;
+        auto op = Previous().type;
         if (op == TokenType::IS || op == TokenType::IS_NOT) {
             auto right = ParseType();
             left = new IsOp({left->getStart(), right->getEnd()}, left, op, right);
@@ -256,7 +256,7 @@ Expression *Parser::ParseNot() {
     while (AdvanceIfMatchAny<TokenType::NOT>()) {
         auto op = Previous();
         auto expr = ParseCompare();
-        left = new UnaryOp({expr->getStart(), op->getEnd()}, TokenType::NOT, expr);
+        left = new UnaryOp({expr->getStart(), op.getEnd()}, TokenType::NOT, expr);
     }
 
     if (left == nullptr) {
@@ -292,7 +292,7 @@ Expression *Parser::ParseExpression() {
 // Statements
 Statement *Parser::ParseVarDecl() {
     bool mutable_;
-    Token *startTok;
+    Token startTok;
     if (AdvanceIfMatchAny<TokenType::LET>()) {
         startTok = Previous();
         mutable_ = false;
@@ -301,7 +301,7 @@ Statement *Parser::ParseVarDecl() {
         mutable_ = true;
     }
     auto identifier = Consume(TokenType::IDENTIFIER);
-    auto var = new Literal(identifier->span, identifier->lexeme, identifier->type);
+    auto var = new Literal(identifier.span, identifier.lexeme.str(), identifier.type);
 
     std::optional<TypeExpr *> type = std::nullopt;
     if (AdvanceIfMatchAny<TokenType::COLON>())
@@ -312,16 +312,16 @@ Statement *Parser::ParseVarDecl() {
         expr = ParseExpression();
 
     if (type == std::nullopt && expr == std::nullopt)
-        throw ParserError(llvm::SMRange{startTok->getStart(), var->getEnd()}, "Expected either a type or a value");
+        throw ParserError(llvm::SMRange{startTok.getStart(), var->getEnd()}, "Expected either a type or a value");
     else if (expr == std::nullopt && !mutable_)
-        throw ParserError(llvm::SMRange{startTok->getStart(), type.value()->getEnd()}, "Cannot declare an immutable variable without an initial expression");
+        throw ParserError(llvm::SMRange{startTok.getStart(), type.value()->getEnd()}, "Cannot declare an immutable variable without an initial expression");
 
     ConsumeNewline();
-    return new VarDecl({startTok->getStart(), expr != std::nullopt ? expr.value()->getEnd() : type.value()->getEnd()}, var, type, expr, mutable_);
+    return new VarDecl({startTok.getStart(), expr != std::nullopt ? expr.value()->getEnd() : type.value()->getEnd()}, var, type, expr, mutable_);
 }
 
 Statement *Parser::ParseIf() {
-    auto loc = Peek()->span;
+    auto loc = Peek().span;
     Consume(TokenType::IF);
 
     auto conds = std::vector<Expression *>();
@@ -336,7 +336,7 @@ Statement *Parser::ParseIf() {
         blocks.push_back(ParseBlock());
     }
     if (AdvanceIfMatchAny<TokenType::ELSE>()) {
-        conds.push_back(new Else(Peek()->span));
+        conds.push_back(new Else(Peek().span));
         blocks.push_back(ParseBlock());
     }
 
@@ -344,7 +344,7 @@ Statement *Parser::ParseIf() {
 }
 
 Statement *Parser::ParseWhile() {
-    auto loc = Peek()->span;
+    auto loc = Peek().span;
     Consume(TokenType::WHILE);
 
     auto cond = ParseExpression();
@@ -368,34 +368,34 @@ Statement *Parser::ParseAssignment() {
 
     if (AdvanceIfMatchAny<TokenType::EQUAL, TokenType::PLUS_EQUAL, TokenType::MINUS_EQUAL, TokenType::STAR_EQUAL,
                           TokenType::SLASH_EQUAL, TokenType::MOD_EQUAL, TokenType::POWER_EQUAL>()) {
-        auto op = Previous()->type;
+        auto op = Previous().type;
         auto expr = ParseExpression();
 
         ConsumeNewline();
         return new Assignment({identifier->getStart(), expr->getEnd()}, identifier, op, expr);
     }
 
-    Error(Peek(), fmt::format("Unsupported assignment operator: {}", Peek()->lexeme));
+    Error(Peek(), fmt::format("Unsupported assignment operator: {}", Peek().lexeme.str()));
 
     return nullptr;
 }
 
 Statement *Parser::ParseBreak() {
-    auto tok = reinterpret_cast<Statement *>(new Break(Consume(TokenType::BREAK)->span));
+    auto tok = reinterpret_cast<Statement *>(new Break(Consume(TokenType::BREAK).span));
     ConsumeNewline();
     return tok;
 }
 
 Statement *Parser::ParseContinue() {
-    auto tok = reinterpret_cast<Statement *>(new Continue(Consume(TokenType::CONTINUE)->span));
+    auto tok = reinterpret_cast<Statement *>(new Continue(Consume(TokenType::CONTINUE).span));
     ConsumeNewline();
     return tok;
 }
 
 Statement *Parser::ParseReturn() {
-    auto loc = Peek()->span;
+    auto loc = Peek().span;
     Consume(TokenType::RETURN);
-    if (Check(TokenType::NEWLINE) || Peek()->type == TokenType::EOF_TOKEN) {
+    if (Check(TokenType::NEWLINE) || Peek().type == TokenType::EOF_TOKEN) {
         ConsumeNewline();
         return reinterpret_cast<Statement *>(new Return(loc, nullptr));
     }
@@ -405,7 +405,7 @@ Statement *Parser::ParseReturn() {
 }
 
 Statement *Parser::ParseDefer() {
-    auto loc = Peek()->span;
+    auto loc = Peek().span;
     Consume(TokenType::DEFER);
     auto val = ParseStatement(false);
     //Don't consume newline, since statement will
@@ -472,7 +472,7 @@ Compound *Parser::ParseBlock() {
 }
 
 Statement *Parser::ParseFunctionDeclaration() {
-    auto loc = isExported ? Previous()->span : Peek()->span;
+    auto loc = isExported ? Previous().span : Peek().span;
     Consume(TokenType::DEF);
     bool extern_func = false;
 
@@ -512,10 +512,10 @@ Statement *Parser::ParseFunctionDeclaration() {
             }
 
             if (default_val == nullptr && type == nullptr) {
-                throw ParserError(param_ident->span, "{} should have either a type, a value or both specified", param_ident->lexeme);
+                throw ParserError(param_ident.span, "{} should have either a type, a value or both specified", param_ident.lexeme.str());
             }
 
-            parameters.emplace_back(new Parameter(param_ident->lexeme, type, false, default_val));
+            parameters.emplace_back(new Parameter(param_ident.lexeme.str(), type, false, default_val));
         }
 
         if (!Check(TokenType::RIGHT_PAREN) && !Check(TokenType::RIGHT_PAREN, 1))
@@ -528,16 +528,16 @@ Statement *Parser::ParseFunctionDeclaration() {
     if (AdvanceIfMatchAny<TokenType::ARROW>())
         return_type = ParseType();
     else
-        return_type = new TypeExpr(Previous()->span, "void", TokenType::VOID_TYPE);
+        return_type = new TypeExpr(Previous().span, "void", TokenType::VOID_TYPE);
 
     if (extern_func) {
         ConsumeNewline();
-        return new ExternFuncDecl({loc.Start, return_type->getEnd()}, identifier->lexeme, return_type, parameters, varargs, isExported);
+        return new ExternFuncDecl({loc.Start, return_type->getEnd()}, identifier.lexeme.str(), return_type, parameters, varargs, isExported);
     }
 
     auto body = ParseBlock();
 
-    return new FuncDecl({loc.Start, return_type->getEnd()}, identifier->lexeme, return_type, parameters, body, false, isExported);
+    return new FuncDecl({loc.Start, return_type->getEnd()}, identifier.lexeme.str(), return_type, parameters, body, false, isExported);
 }
 
 Statement *Parser::ParseExport() {
@@ -567,60 +567,65 @@ Statement *Parser::ParseExport() {
 }
 
 Statement *Parser::ParseImport() {
-    auto loc = Peek()->span;
+    auto loc = Peek().span;
     bool selectiveImport = false;
     if (AdvanceIfMatchAny<TokenType::FROM>())
         selectiveImport = true;
     else
         Consume(TokenType::IMPORT);
 
-    Token *token;
+    Token token;
     std::string filepath;
 
-    if (Peek()->type == TokenType::STRING) {
+    if (Peek().type == TokenType::STRING) {
         token = Consume(TokenType::STRING);
-        filepath = token->lexeme;
-    } else if (Peek()->type == TokenType::IDENTIFIER) {
+        filepath = token.lexeme.str();
+    } else if (Peek().type == TokenType::IDENTIFIER) {
         token = Consume(TokenType::IDENTIFIER);
-        filepath = getStdDir() + token->lexeme + ".les";
+        filepath = getStdDir() + token.lexeme.str() + ".les";
     } else {
         Error(Peek(), "Imports must be either strings for files or identifiers for standard library");
         return nullptr;
     }
 
+    // The lexeme of a string is released while the parser advances, what's read from the token is copied first
+    auto basename = getBasename(token.lexeme.str());
+    auto end = token.getEnd();
+    bool isStd = token.type == TokenType::IDENTIFIER;
+
     if (!selectiveImport) {
-        std::string alias = getBasename(token->lexeme);
+        std::string alias = basename;
         if (AdvanceIfMatchAny<TokenType::AS>())
-            alias = Consume(TokenType::IDENTIFIER)->lexeme;
+            alias = Consume(TokenType::IDENTIFIER).lexeme.str();
 
         ConsumeNewline();
-        return new Import({loc.Start, token->getEnd()}, filepath, alias, token->type == TokenType::IDENTIFIER, true, false, {});
+        return new Import({loc.Start, end}, filepath, alias, isStd, true, false, {});
     } else {
         Consume(TokenType::IMPORT);
 
         if (AdvanceIfMatchAny<TokenType::STAR>()) {
             ConsumeNewline();
-            return new Import({loc.Start, token->getEnd()}, filepath, getBasename(token->lexeme), token->type == TokenType::IDENTIFIER, true, true, {});
+            return new Import({loc.Start, end}, filepath, basename, isStd, true, true, {});
         } else {
             std::vector<std::pair<std::string, std::string>> imported_names;
 
             do {
-                auto ident = Consume(TokenType::IDENTIFIER)->lexeme;
+                auto ident = Consume(TokenType::IDENTIFIER).lexeme.str();
                 auto alias = ident;
                 if (AdvanceIfMatchAny<TokenType::AS>())
-                    alias = Consume(TokenType::IDENTIFIER)->lexeme;
+                    alias = Consume(TokenType::IDENTIFIER).lexeme.str();
 
                 imported_names.emplace_back(ident, alias);
             } while (AdvanceIfMatchAny<TokenType::COMMA>());
 
             ConsumeNewline();
-            return new Import({loc.Start, token->getEnd()}, filepath, getBasename(token->lexeme), token->type == TokenType::IDENTIFIER, false, true, imported_names);
+            return new Import({loc.Start, end}, filepath, basename, isStd, false, true, imported_names);
         }
     }
 }
 
 Statement *Parser::ParseClass() {
-    auto loc = Peek()->span;
+    auto loc = Peek().span;
     Consume(TokenType::CLASS);
 
     auto token = Consume(TokenType::IDENTIFIER);
@@ -643,11 +648,11 @@ Statement *Parser::ParseClass() {
 
     AdvanceIfMatchAny<TokenType::DEDENT>();
 
-    return new Class(loc, token->lexeme, fields, methods, isExported);
+    return new Class(loc, token.lexeme.str(), fields, methods, isExported);
 }
 
 Statement *Parser::ParseEnum() {
-    auto loc = Peek()->span;
+    auto loc = Peek().span;
     Consume(TokenType::ENUM);
 
     auto token = Consume(TokenType::IDENTIFIER);
@@ -657,20 +662,20 @@ Statement *Parser::ParseEnum() {
     Consume(TokenType::INDENT);
 
     while (!CheckAny<TokenType::DEDENT, TokenType::EOF_TOKEN>()) {
-        values.push_back(Consume(TokenType::IDENTIFIER)->lexeme);
+        values.push_back(Consume(TokenType::IDENTIFIER).lexeme.str());
         Consume(TokenType::NEWLINE);
     }
 
     AdvanceIfMatchAny<TokenType::DEDENT>();
 
-    return new Enum(loc, token->lexeme, values, isExported);
+    return new Enum(loc, token.lexeme.str(), values, isExported);
 }
 
 Compound *Parser::ParseCompound() {
     std::vector<Statement *> statements;
     while (!IsAtEnd()) {
         // Remove lingering newlines
-        while (Peek()->type == TokenType::NEWLINE)
+        while (Peek().type == TokenType::NEWLINE)
             Consume(TokenType::NEWLINE);
         statements.push_back(ParseStatement(true));
     }
@@ -680,3 +685,20 @@ Compound *Parser::ParseCompound() {
 void Parser::Parse() {
     tree = ParseCompound();
 }
+
+/**
+ * Parse only the import statements, used to discover the imported modules before compiling them
+ *
+ * @return Import statements, owned by the caller
+ */
+std::vector<Import *> Parser::ParseImports() {
+    std::vector<Import *> imports;
+    while (!IsAtEnd()) {
+        if (CheckAny<TokenType::IMPORT, TokenType::FROM>())
+            imports.push_back(static_cast<Import *>(ParseImport()));
+        else
+            Advance();
+    }
+
+    return imports;
+}
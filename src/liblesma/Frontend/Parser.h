@@ -3,6 +3,7 @@
 #include "Lexer.h"
 #include "liblesma/AST/AST.h"
 #include "liblesma/Common/LesmaError.h"
+#include <algorithm>
 #include <memory>
 #include <utility>
 
@@ -14,32 +15,41 @@ namespace lesma {
 
     class Parser {
     public:
-        explicit Parser(std::vector<Token *> tokens) : tokens(std::move(tokens)), index(0), tree(nullptr) {}
+        explicit Parser(Lexer &lexer) : lexer(lexer), tokens(lexer.getTokens()), index(0), tree(nullptr) {}
         ~Parser() {
             delete tree;
         }
 
         void Parse();
+        std::vector<Import *> ParseImports();
 
         Compound *getAST() { return tree; }
 
     protected:
-        Token *Peek() { return Peek(0); }
-        Token *Peek(unsigned long i) { return tokens.at(index + i); }
+        // Tokens are scanned as far as the lookahead reads, past the end it reads the last token, which is EOF
+        unsigned long Position(unsigned long i) {
+            lexer.ScanUntil(index + i);
+            return std::min<unsigned long>(index + i, tokens.size() - 1);
+        }
+
+        Token Peek() { return Peek(0); }
+        Token Peek(unsigned long i) { return tokens[Position(i)]; }
 
-        Token *Consume(TokenType type);
-        Token *Consume(TokenType type, const std::string &error_message);
-        Token *ConsumeNewline();
+        Token Consume(TokenType type);
+        Token Consume(TokenType type, const std::string &error_message);
+        Token ConsumeNewline();
 
-        Token *Previous() { return Peek(-1); }
+        Token Previous() { return tokens[std::max<unsigned long>(index, 1) - 1]; }
 
-        bool IsAtEnd() { return Peek()->type == TokenType::EOF_TOKEN; }
+        bool IsAtEnd() { return tokens.getType(Position(0)) == TokenType::EOF_TOKEN; }
 
-        Token *Advance() {
-            if (!IsAtEnd())
+        Token Advance() {
+            if (!IsAtEnd()) {
                 index++;
+                lexer.Release(index - 1);
+            }
 
-            return Peek(-1);
+            return Previous();
         }
 
         bool Check(TokenType type) {
@@ -47,7 +57,7 @@ namespace lesma {
         }
 
         bool Check(TokenType type, unsigned long pos) {
-            return Peek(pos)->type == type;
+            return tokens.getType(Position(pos)) == type;
         }
 
         template<TokenType type, TokenType... remained_types>
@@ -62,13 +72,14 @@ namespace lesma {
         template<TokenType type, TokenType... remained_types>
         bool CheckAny(unsigned long pos);
 
-        const std::vector<Token *> tokens;
+        Lexer &lexer;
+        const TokenBuffer &tokens;
         unsigned long index;
         bool inClass = false;
         bool isExported = false;
         Compound *tree;
 
-        static void Error(Token *token, const std::string &basicString);
+        static void Error(const Token &token, const std::string &basicString);
 
         Compound *ParseCompound();
         Compound *ParseBlock();
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#define LESMA_SCAN_SIMD
+#endif
+
+namespace lesma {
+    /**
+     * Scanning of runs of characters for the lexer, a block of 32 bytes at a time with AVX2 or 16 bytes with SSE2,
+     * depending on the target the compiler is building for, and a byte at a time for the rest of the buffer.
+     * Every function returns the first position in [ptr, end) which doesn't belong to the run, or end.
+     */
+    class Scan {
+    public:
+        static const char *SkipIdentifier(const char *ptr, const char *end) {
+            return Skip(ptr, end, [](auto x) { return IsIdentifier(x); });
+        }
+
+        static const char *SkipDigits(const char *ptr, const char *end) {
+            return Skip(ptr, end, [](auto x) { return IsDigit(x); });
+        }
+
+        static const char *SkipByte(const char *ptr, const char *end, char c) {
+            return Skip(ptr, end, [c](auto x) { return Equal(x, c); });
+        }
+
+        static const char *FindNewline(const char *ptr, const char *end) {
+            return Find(ptr, end, [](auto x) { return Equal(x, '\n'); });
+        }
+
+        // A string body ends at the closing quote, at an escape sequence, or at a newline, which updates the line
+        static const char *FindStringEnd(const char *ptr, const char *end) {
+            return Find(ptr, end, [](auto x) { return Or(Or(Equal(x, '"'), Equal(x, '\\')), Equal(x, '\n')); });
+        }
+
+    private:
+        static bool Equal(char a, char b) { return a == b; }
+        static bool Or(bool a, bool b) { return a || b; }
+        static bool InRange(char c, char lo, char hi) { return c >= lo && c <= hi; }
+        static bool IsDigit(char c) { return InRange(c, '0', '9'); }
+        static bool IsIdentifier(char c) { return InRange(static_cast<char>(c | 0x20), 'a', 'z') || IsDigit(c) || c == '_'; }
+
+#ifdef LESMA_SCAN_SIMD
+#if defined(__AVX2__)
+        using Block = __m256i;
+        static constexpr uint32_t FULL_MASK = 0xFFFFFFFF;
+
+        static Block Load(const char *ptr) { return _mm256_loadu_si256(reinterpret_cast<const Block *>(ptr)); }
+        static Block Splat(char c) { return _mm256_set1_epi8(c); }
+        static Block Equal(Block a, Block b) { return _mm256_cmpeq_epi8(a, b); }
+        static Block Greater(Block a, Block b) { return _mm256_cmpgt_epi8(a, b); }
+        static Block Or(Block a, Block b) { return _mm256_or_si256(a, b); }
+        static Block And(Block a, Block b) { return _mm256_and_si256(a, b); }
+        static uint32_t Mask(Block a) { return static_cast<uint32_t>(_mm256_movemask_epi8(a)); }
+#else
+        using Block = __m128i;
+        static constexpr uint32_t FULL_MASK = 0xFFFF;
+
+        static Block Load(const char *ptr) { return _mm_loadu_si128(reinterpret_cast<const Block *>(ptr)); }
+        static Block Splat(char c) { return _mm_set1_epi8(c); }
+        static Block Equal(Block a, Block b) { return _mm_cmpeq_epi8(a, b); }
+        static Block Greater(Block a, Block b) { return _mm_cmpgt_epi8(a, b); }
+        static Block Or(Block a, Block b) { return _mm_or_si128(a, b); }
+        static Block And(Block a, Block b) { return _mm_and_si128(a, b); }
+        static uint32_t Mask(Block a) { return static_cast<uint32_t>(_mm_movemask_epi8(a)); }
+#endif
+
+        // Bytes are compared as signed, so non-ASCII bytes are never in the ASCII ranges
+        static Block Equal(Block x, char c) { return Equal(x, Splat(c)); }
+        static Block InRange(Block x, char lo, char hi) { return And(Greater(x, Splat(static_cast<char>(lo - 1))), Greater(Splat(static_cast<char>(hi + 1)), x)); }
+        static Block IsDigit(Block x) { return InRange(x, '0', '9'); }
+        static Block IsIdentifier(Block x) { return Or(Or(InRange(Or(x, Splat(0x20)), 'a', 'z'), IsDigit(x)), Equal(x, '_')); }
+#endif
+
+        template<typename Match>
+        static const char *Skip(const char *ptr, const char *end, Match match) {
+#ifdef LESMA_SCAN_SIMD
+            while (end - ptr >= static_cast<long>(sizeof(Block))) {
+                auto mismatch = ~Mask(match(Load(ptr))) & FULL_MASK;
+                if (mismatch != 0)
+                    return ptr + __builtin_ctz(mismatch);
+                ptr += sizeof(Block);
+            }
+#endif
+            while (ptr != end && match(*ptr))
+                ptr++;
+            return ptr;
+        }
+
+        template<typename Match>
+        static const char *Find(const char *ptr, const char *end, Match match) {
+#ifdef LESMA_SCAN_SIMD
+            while (end - ptr >= static_cast<long>(sizeof(Block))) {
+                auto found = Mask(match(Load(ptr)));
+                if (found != 0)
+                    return ptr + __builtin_ctz(found);
+                ptr += sizeof(Block);
+            }
+#endif
+            while (ptr != end && !match(*ptr))
+                ptr++;
+            return ptr;
+        }
+    };
+}// namespace lesma
\ No newline at end of file
@@ -0,0 +1,334 @@
+#include "ModuleInterface.h"
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/GlobalVariable.h>
+
+using namespace lesma;
+
+/**
+ * Collect the exported classes, enums and functions of a compiled module
+ *
+ * @param scope Top-level symbol table of the compiled module
+ * @param dependencies Modules imported by the compiled module
+ * @return Interface of the module
+ */
+ModuleInterface ModuleInterface::Create(SymbolTable *scope, std::vector<ModuleDependency> dependencies) {
+    ModuleInterface interface;
+    interface.dependencies = std::move(dependencies);
+
+    for (const auto &[name, symbol]: scope->getSymbols()) {
+        if (!symbol->isExported())
+            continue;
+
+        if (symbol->getType()->isOneOf({TY_CLASS, TY_ENUM})) {
+            interface.symbols.push_back(llvm::json::Object{
+                    {"kind", "struct"},
+                    {"name", name},
+                    {"struct", symbol->getType()->getLLVMType()->getStructName().str()},
+                    {"base", static_cast<int64_t>(symbol->getType()->getBaseType())},
+                    {"fields", EncodeFields(symbol->getType())},
+            });
+        } else if (symbol->getType()->is(TY_FUNCTION)) {
+            interface.symbols.push_back(llvm::json::Object{
+                    {"kind", "function"},
+                    {"name", name},
+                    {"mangled", symbol->getMangledName()},
+                    {"type", EncodeType(symbol->getType())},
+            });
+        }
+    }
+
+    return interface;
+}
+
+/**
+ * Read an interface previously written by Serialize
+ *
+ * @param json Serialized interface
+ * @return Interface, or std::nullopt if the input is malformed
+ */
+std::optional<ModuleInterface> ModuleInterface::Parse(llvm::StringRef json) {
+    auto parsed = llvm::json::parse(json);
+    if (!parsed) {
+        llvm::consumeError(parsed.takeError());
+        return std::nullopt;
+    }
+
+    auto *root = parsed->getAsObject();
+    if (root == nullptr || root->getArray("symbols") == nullptr || root->getArray("dependencies") == nullptr)
+        return std::nullopt;
+
+    ModuleInterface interface;
+    interface.symbols = std::move(*root->getArray("symbols"));
+    for (const auto &entry: *root->getArray("dependencies")) {
+        auto *dependency = entry.getAsObject();
+        if (dependency == nullptr || !dependency->getString("path") || !dependency->getString("alias") || !dependency->getString("key"))
+            return std::nullopt;
+
+        interface.dependencies.push_back({dependency->getString("path")->str(), dependency->getString("alias")->str(), dependency->getString("key")->str()});
+    }
+
+    return interface;
+}
+
+std::string ModuleInterface::Serialize() const {
+    llvm::json::Array deps;
+    for (const auto &dependency: dependencies)
+        deps.push_back(llvm::json::Object{{"path", dependency.path}, {"alias", dependency.alias}, {"key", dependency.key}});
+
+    std::string output;
+    llvm::raw_string_ostream oss(output);
+    oss << llvm::json::Value(llvm::json::Object{{"symbols", llvm::json::Array(symbols)}, {"dependencies", std::move(deps)}});
+
+    return oss.str();
+}
+
+/**
+ * Recreate the exported symbols in the context of the importing module. Functions are not declared,
+ * the importer declares the ones it imports under their mangled names.
+ *
+ * @param module Importing module
+ * @return Exported symbols
+ */
+std::vector<Value *> ModuleInterface::Materialize(llvm::Module &module) const {
+    std::vector<Value *> values;
+    std::map<std::string, Type *> structs;
+    auto &context = module.getContext();
+
+    // Create the classes and enums first, signatures and fields can refer to them
+    for (const auto &entry: symbols) {
+        auto *symbol = entry.getAsObject();
+        if (symbol == nullptr || symbol->getString("kind") != llvm::StringRef("struct"))
+            continue;
+
+        auto name = symbol->getString("struct").value_or("").str();
+        auto *structType = llvm::StructType::getTypeByName(context, name);
+        if (structType == nullptr)
+            structType = llvm::StructType::create(context, name);
+
+        structs.insert_or_assign(name, new Type(static_cast<BaseType>(symbol->getInteger("base").value_or(TY_CLASS)), structType));
+    }
+
+    for (const auto &entry: symbols) {
+        auto *symbol = entry.getAsObject();
+        if (symbol == nullptr)
+            continue;
+
+        auto name = symbol->getString("name").value_or("").str();
+        if (symbol->getString("kind") == llvm::StringRef("struct")) {
+            auto *type = structs.at(symbol->getString("struct").value_or("").str());
+            type->setFields(DecodeFields(symbol->getArray("fields"), module, structs));
+
+            auto *structType = llvm::cast<llvm::StructType>(type->getLLVMType());
+            if (structType->isOpaque()) {
+                std::vector<llvm::Type *> elementTypes;
+                if (type->is(TY_ENUM)) {
+                    elementTypes.push_back(llvm::Type::getInt8Ty(context));
+                } else {
+                    for (auto field: type->getFields())
+                        elementTypes.push_back(field->type->getLLVMType());
+                }
+                structType->setBody(elementTypes);
+            }
+
+            auto *value = new Value(name, type);
+            value->setExported(true);
+            values.push_back(value);
+        } else if (symbol->getString("kind") == llvm::StringRef("function")) {
+            auto *type = DecodeType(symbol->getObject("type"), module, structs);
+            if (type == nullptr || !type->is(TY_FUNCTION))
+                continue;
+
+            auto *value = new Value(name, type);
+            value->setMangledName(symbol->getString("mangled").value_or(name).str());
+            value->setExported(true);
+            values.push_back(value);
+        }
+    }
+
+    return values;
+}
+
+llvm::json::Value ModuleInterface::EncodeType(Type *type) {
+    if (type == nullptr)
+        return nullptr;
+
+    llvm::json::Object result{{"base", static_cast<int64_t>(type->getBaseType())}};
+    auto *llvmType = type->getLLVMType();
+
+    switch (type->getBaseType()) {
+        case TY_INT:
+            result["bits"] = static_cast<int64_t>(llvmType->getIntegerBitWidth());
+            break;
+        case TY_FLOAT:
+            result["bits"] = llvmType->isFloatTy() ? 32 : 64;
+            break;
+        case TY_PTR:
+            result["element"] = EncodeType(type->getElementType());
+            break;
+        case TY_ARRAY:
+            result["element"] = EncodeType(type->getElementType());
+            result["size"] = static_cast<int64_t>(llvmType->getArrayNumElements());
+            break;
+        case TY_FUNCTION:
+            result["fields"] = EncodeFields(type);
+            result["return"] = EncodeType(type->getReturnType());
+            result["pointer"] = llvmType->isPointerTy();
+            result["varargs"] = llvmType->isFunctionTy() && llvm::cast<llvm::FunctionType>(llvmType)->isVarArg();
+            break;
+        case TY_CLASS:
+        case TY_ENUM:
+            // Only referenced by name, the layout is stored with the struct symbol
+            result["name"] = llvmType->getStructName().str();
+            break;
+        default:
+            break;
+    }
+
+    return result;
+}
+
+llvm::json::Value ModuleInterface::EncodeFields(Type *type) {
+    llvm::json::Array fields;
+    for (auto field: type->getFields()) {
+        llvm::json::Object encoded{{"name", field->name}, {"type", EncodeType(field->type)}};
+        if (field->defaultValue != nullptr)
+            encoded["default"] = EncodeDefaultValue(field->defaultValue);
+        fields.push_back(std::move(encoded));
+    }
+
+    return fields;
+}
+
+llvm::json::Value ModuleInterface::EncodeDefaultValue(Value *value) {
+    auto *llvmValue = value->getLLVMValue();
+    if (llvmValue == nullptr)
+        return nullptr;
+
+    if (auto *constInt = llvm::dyn_cast<llvm::ConstantInt>(llvmValue))
+        return llvm::json::Object{{"int", constInt->getSExtValue()}};
+    if (auto *constFP = llvm::dyn_cast<llvm::ConstantFP>(llvmValue))
+        return llvm::json::Object{{"float", constFP->getValueAPF().convertToDouble()}};
+    if (llvm::isa<llvm::ConstantPointerNull>(llvmValue))
+        return llvm::json::Object{{"null", true}};
+
+    // String literals are private globals of the defining module
+    auto *global = llvm::dyn_cast<llvm::GlobalVariable>(llvmValue->stripPointerCasts());
+    if (global != nullptr && global->hasInitializer()) {
+        auto *data = llvm::dyn_cast<llvm::ConstantDataSequential>(global->getInitializer());
+        if (data != nullptr && data->isCString())
+            return llvm::json::Object{{"string", data->getAsCString().str()}};
+    }
+
+    return nullptr;
+}
+
+Type *ModuleInterface::DecodeType(const llvm::json::Object *type, llvm::Module &module, std::map<std::string, Type *> &structs) const {
+    if (type == nullptr)
+        return nullptr;
+
+    auto &context = module.getContext();
+    auto base = static_cast<BaseType>(type->getInteger("base").value_or(TY_INVALID));
+
+    switch (base) {
+        case TY_INT:
+            return new Type(TY_INT, llvm::IntegerType::get(context, type->getInteger("bits").value_or(64)));
+        case TY_FLOAT:
+            return new Type(TY_FLOAT, type->getInteger("bits").value_or(64) == 32 ? llvm::Type::getFloatTy(context) : llvm::Type::getDoubleTy(context));
+        case TY_BOOL:
+            return new Type(TY_BOOL, llvm::Type::getInt1Ty(context));
+        case TY_STRING:
+            return new Type(TY_STRING, llvm::Type::getInt8PtrTy(context));
+        case TY_VOID:
+            return new Type(TY_VOID, llvm::Type::getVoidTy(context));
+        case TY_PTR:
+            return new Type(TY_PTR, llvm::PointerType::get(context, 0), DecodeType(type->getObject("element"), module, structs));
+        case TY_ARRAY: {
+            auto *element = DecodeType(type->getObject("element"), module, structs);
+            if (element == nullptr)
+                return nullptr;
+
+            return new Type(TY_ARRAY, llvm::ArrayType::get(element->getLLVMType(), type->getInteger("size").value_or(0)), element);
+        }
+        case TY_FUNCTION: {
+            auto fields = DecodeFields(type->getArray("fields"), module, structs);
+            auto *returnType = DecodeType(type->getObject("return"), module, structs);
+
+            llvm::Type *llvmType;
+            if (type->getBoolean("pointer").value_or(false)) {
+                llvmType = llvm::PointerType::get(context, 0);
+            } else {
+                std::vector<llvm::Type *> paramTypes;
+                for (auto field: fields)
+                    paramTypes.push_back(field->type->getLLVMType());
+
+                llvmType = llvm::FunctionType::get(returnType != nullptr ? returnType->getLLVMType() : llvm::Type::getVoidTy(context),
+                                                   paramTypes, type->getBoolean("varargs").value_or(false));
+            }
+
+            auto *funcType = new Type(TY_FUNCTION, llvmType, std::move(fields));
+            funcType->setReturnType(returnType);
+            return funcType;
+        }
+        case TY_CLASS:
+        case TY_ENUM: {
+            auto name = type->getString("name").value_or("").str();
+            if (structs.find(name) == structs.end()) {
+                // Struct from another module, we only need to know it by name
+                auto *structType = llvm::StructType::getTypeByName(context, name);
+                if (structType == nullptr)
+                    structType = llvm::StructType::create(context, name);
+
+                structs.insert_or_assign(name, new Type(base, structType));
+            }
+
+            return structs.at(name);
+        }
+        default:
+            return nullptr;
+    }
+}
+
+std::vector<Field *> ModuleInterface::DecodeFields(const llvm::json::Array *fields, llvm::Module &module, std::map<std::string, Type *> &structs) const {
+    std::vector<Field *> result;
+    if (fields == nullptr)
+        return result;
+
+    for (const auto &entry: *fields) {
+        auto *field = entry.getAsObject();
+        if (field == nullptr)
+            continue;
+
+        auto *type = DecodeType(field->getObject("type"), module, structs);
+        if (type == nullptr)
+            type = new Type(TY_INVALID);
+
+        result.push_back(new Field{field->getString("name").value_or("").str(), type, DecodeDefaultValue(field->getObject("default"), type, module)});
+    }
+
+    return result;
+}
+
+Value *ModuleInterface::DecodeDefaultValue(const llvm::json::Object *value, Type *type, llvm::Module &module) const {
+    if (value == nullptr || type->getLLVMType() == nullptr)
+        return nullptr;
+
+    auto &context = module.getContext();
+    llvm::Constant *constant = nullptr;
+
+    if (auto integer = value->getInteger("int"))
+        constant = llvm::ConstantInt::getSigned(type->getLLVMType(), *integer);
+    else if (auto number = value->getNumber("float"))
+        constant = llvm::ConstantFP::get(type->getLLVMType(), *number);
+    else if (value->getBoolean("null"))
+        constant = llvm::Constant::getNullValue(llvm::Type::getInt8PtrTy(context));
+    else if (auto string = value->getString("string")) {
+        auto *init = llvm::ConstantDataArray::getString(context, *string);
+        auto *global = new llvm::GlobalVariable(module, init->getType(), true, llvm::GlobalValue::PrivateLinkage, init, ".str");
+        global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        global->setAlignment(llvm::Align(1));
+        constant = global;
+    }
+
+    return constant != nullptr ? new Value("", type, constant) : nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <llvm/IR/Module.h>
+#include <llvm/Support/JSON.h>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "SymbolTable.h"
+
+namespace lesma {
+    /**
+     * Module imported while compiling another module, identified by its path, alias and cache key
+     */
+    struct ModuleDependency {
+        std::string path;
+        std::string alias;
+        std::string key;
+    };
+
+    /**
+     * Serializable manifest of the symbols exported by a compiled module. It allows importing a
+     * module without lexing, parsing and generating code for it again.
+     */
+    class ModuleInterface {
+    public:
+        ModuleInterface() = default;
+
+        static ModuleInterface Create(SymbolTable *scope, std::vector<ModuleDependency> dependencies);
+        static std::optional<ModuleInterface> Parse(llvm::StringRef json);
+        [[nodiscard]] std::string Serialize() const;
+
+        std::vector<Value *> Materialize(llvm::Module &module) const;
+
+        [[nodiscard]] const std::vector<ModuleDependency> &getDependencies() const { return dependencies; }
+
+    private:
+        llvm::json::Array symbols;
+        std::vector<ModuleDependency> dependencies;
+
+        static llvm::json::Value EncodeType(Type *type);
+        static llvm::json::Value EncodeFields(Type *type);
+        static llvm::json::Value EncodeDefaultValue(Value *value);
+
+        Type *DecodeType(const llvm::json::Object *type, llvm::Module &module, std::map<std::string, Type *> &structs) const;
+        std::vector<Field *> DecodeFields(const llvm::json::Array *fields, llvm::Module &module, std::map<std::string, Type *> &structs) const;
+        Value *DecodeDefaultValue(const llvm::json::Object *value, Type *type, llvm::Module &module) const;
+    };
+}// namespace lesma
\ No newline at end of file
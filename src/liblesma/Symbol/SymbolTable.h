@@ -6,10 +6,11 @@
 #include <utility>
 
 #include "Value.h"
+#include "liblesma/Common/MemoryReport.h"
 #include "liblesma/Common/Utils.h"
 
 namespace lesma {
-    class SymbolTable {
+    class SymbolTable : public MemoryTracked<MemoryCategory::SymbolTables> {
     public:
         explicit SymbolTable(SymbolTable *parent) : parent(parent){};
         ~SymbolTable() {
@@ -32,6 +33,8 @@ namespace lesma {
         SymbolTable *getParent();
         std::unordered_multimap<std::string, Value *> getSymbols() { return symbols; }
         std::unordered_map<std::string, Type *> getTypes() { return types; }
+        void setSymbols(std::unordered_multimap<std::string, Value *> symbols_) { symbols = std::move(symbols_); }
+        void setTypes(std::unordered_map<std::string, Type *> types_) { types = std::move(types_); }
 
         SymbolTable *getChild(const std::string &tableName);
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "liblesma/Common/MemoryReport.h"
 #include "liblesma/Symbol/Value.h"
 #include <algorithm>
 #include <llvm/IR/Type.h>
@@ -35,7 +36,7 @@ namespace lesma {
         Value *defaultValue = nullptr;
     };
 
-    class Type {
+    class Type : public MemoryTracked<MemoryCategory::Types> {
         BaseType baseType;
         llvm::Type *llvmType;
 
@@ -66,6 +67,7 @@ namespace lesma {
         void setBaseType(BaseType type) { baseType = type; }
         void setElementType(lesma::Type *type) { elementType = type; }
         void setReturnType(lesma::Type *type) { returnType = type; }
+        void setFields(std::vector<Field *> fields_) { fields = std::move(fields_); }
 
         bool isEqual(Type *rhs) {
             if (rhs == nullptr)
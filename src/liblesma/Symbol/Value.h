@@ -6,6 +6,7 @@
 #include <utility>
 
 #include "Type.h"
+#include "liblesma/Common/MemoryReport.h"
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
 
@@ -18,7 +19,7 @@ namespace lesma {
     /**
      * Entry of a symbol table, representing an individual symbol with all its properties
      */
-    class Value {
+    class Value : public MemoryTracked<MemoryCategory::Values> {
     public:
         explicit Value(Type *type) : state(INITIALIZED),
                                      type(type) {}
@@ -6,95 +6,127 @@ std::string Token::Dump(const std::shared_ptr<llvm::SourceMgr> &srcMgr) const {
     return std::string(
                    "[Type: ") +
            std::string{NAMEOF_ENUM(type)} +
-           ", Lexeme: " + lexeme +
+           ", Lexeme: " + lexeme.str() +
            ", Line: " + std::to_string(srcMgr->getLineAndColumn(span.Start, srcMgr->getNumBuffers() - 1).first) + " - " + std::to_string(srcMgr->getLineAndColumn(span.End, srcMgr->getNumBuffers() - 1).first) +
            ", Col: " + std::to_string(srcMgr->getLineAndColumn(span.Start, srcMgr->getNumBuffers() - 1).second) + " - " + std::to_string(srcMgr->getLineAndColumn(span.End, srcMgr->getNumBuffers() - 1).second) + "]";
 }
 
-TokenType Token::GetIdentifierType(const std::string &identifier, Token *lastTok) {
+static TokenType Match(llvm::StringRef identifier, llvm::StringRef keyword, TokenType type) {
+    return identifier == keyword ? type : TokenType::IDENTIFIER;
+}
+
+/**
+ * Find the keyword type of an identifier, by switching on its length and on characters which tell apart the
+ * keywords of that length, so it's compared with a single keyword at most
+ *
+ * @param identifier Identifier
+ * @return Type of the keyword, or IDENTIFIER
+ */
+static TokenType GetKeywordType(llvm::StringRef identifier) {
+    switch (identifier.size()) {
+        case 2:
+            switch (identifier[0]) {
+                case 'a':
+                    return Match(identifier, "as", TokenType::AS);
+                case 'o':
+                    return Match(identifier, "or", TokenType::OR);
+                case 'i':
+                    switch (identifier[1]) {
+                        case 'f':
+                            return TokenType::IF;
+                        case 'n':
+                            return TokenType::IN;
+                        case 's':
+                            return TokenType::IS;
+                    }
+            }
+            break;
+        case 3:
+            switch (identifier[0]) {
+                case 'a':
+                    return Match(identifier, "and", TokenType::AND);
+                case 'd':
+                    return Match(identifier, "def", TokenType::DEF);
+                case 'f':
+                    return Match(identifier, "for", TokenType::FOR);
+                case 'i':
+                    return Match(identifier, "int", TokenType::INT_TYPE);
+                case 'l':
+                    return Match(identifier, "let", TokenType::LET);
+                case 'n':
+                    return Match(identifier, "not", TokenType::NOT);
+                case 's':
+                    return Match(identifier, "str", TokenType::STRING_TYPE);
+                case 'v':
+                    return Match(identifier, "var", TokenType::VAR);
+            }
+            break;
+        case 4:
+            switch (identifier[1]) {
+                case 'o':
+                    return identifier[0] == 'b' ? Match(identifier, "bool", TokenType::BOOL_TYPE) : Match(identifier, "void", TokenType::VOID_TYPE);
+                case 'l':
+                    return Match(identifier, "else", TokenType::ELSE);
+                case 'n':
+                    return identifier[0] == 'e' ? Match(identifier, "enum", TokenType::ENUM) : Match(identifier, "int8", TokenType::INT8_TYPE);
+                case 'r':
+                    return identifier[0] == 'f' ? Match(identifier, "from", TokenType::FROM) : Match(identifier, "true", TokenType::TRUE_);
+                case 'u':
+                    return identifier[0] == 'f' ? Match(identifier, "func", TokenType::FUNC) : Match(identifier, "null", TokenType::NIL);
+                case 'h':
+                    return Match(identifier, "this", TokenType::THIS);
+            }
+            break;
+        case 5:
+            switch (identifier[0]) {
+                case 'b':
+                    return Match(identifier, "break", TokenType::BREAK);
+                case 'c':
+                    return Match(identifier, "class", TokenType::CLASS);
+                case 'd':
+                    return Match(identifier, "defer", TokenType::DEFER);
+                case 'f':
+                    return identifier[1] == 'a' ? Match(identifier, "false", TokenType::FALSE_) : Match(identifier, "float", TokenType::FLOAT_TYPE);
+                case 'i':
+                    switch (identifier[4]) {
+                        case '6':
+                            return Match(identifier, "int16", TokenType::INT16_TYPE);
+                        case '2':
+                            return Match(identifier, "int32", TokenType::INT32_TYPE);
+                        case '4':
+                            return Match(identifier, "int64", TokenType::INT_TYPE);
+                    }
+                    break;
+                case 's':
+                    return Match(identifier, "super", TokenType::SUPER);
+                case 'w':
+                    return Match(identifier, "while", TokenType::WHILE);
+            }
+            break;
+        case 6:
+            switch (identifier[2]) {
+                case 'p':
+                    return identifier[0] == 'e' ? Match(identifier, "export", TokenType::EXPORT) : Match(identifier, "import", TokenType::IMPORT);
+                case 't':
+                    return identifier[0] == 'e' ? Match(identifier, "extern", TokenType::EXTERN) : Match(identifier, "return", TokenType::RETURN);
+            }
+            break;
+        case 7:
+            return Match(identifier, "float32", TokenType::FLOAT32_TYPE);
+        case 8:
+            return Match(identifier, "continue", TokenType::CONTINUE);
+    }
+
+    return TokenType::IDENTIFIER;
+}
+
+TokenType Token::GetIdentifierType(llvm::StringRef identifier, TokenType lastType) {
     // Multi-word keywords first
-    if (identifier == "if" and lastTok->type == TokenType::ELSE)
+    if (identifier == "if" && lastType == TokenType::ELSE)
         return TokenType::ELSE_IF;
-    else if (identifier == "not" and lastTok->type == TokenType::IS)
+    else if (identifier == "not" && lastType == TokenType::IS)
         return TokenType::IS_NOT;
 
     // Single word keywords
-    else if (identifier == "and")
-        return TokenType::AND;
-    else if (identifier == "class")
-        return TokenType::CLASS;
-    else if (identifier == "enum")
-        return TokenType::ENUM;
-    else if (identifier == "else")
-        return TokenType::ELSE;
-    else if (identifier == "false")
-        return TokenType::FALSE_;
-    else if (identifier == "for")
-        return TokenType::FOR;
-    else if (identifier == "def")
-        return TokenType::DEF;
-    else if (identifier == "defer")
-        return TokenType::DEFER;
-    else if (identifier == "func")
-        return TokenType::FUNC;
-    else if (identifier == "if")
-        return TokenType::IF;
-    else if (identifier == "not")
-        return TokenType::NOT;
-    else if (identifier == "null")
-        return TokenType::NIL;
-    else if (identifier == "or")
-        return TokenType::OR;
-    else if (identifier == "return")
-        return TokenType::RETURN;
-    else if (identifier == "this")
-        return TokenType::THIS;
-    else if (identifier == "true")
-        return TokenType::TRUE_;
-    else if (identifier == "var")
-        return TokenType::VAR;
-    else if (identifier == "let")
-        return TokenType::LET;
-    else if (identifier == "while")
-        return TokenType::WHILE;
-    else if (identifier == "break")
-        return TokenType::BREAK;
-    else if (identifier == "continue")
-        return TokenType::CONTINUE;
-    else if (identifier == "super")
-        return TokenType::SUPER;
-    else if (identifier == "extern")
-        return TokenType::EXTERN;
-    else if (identifier == "export")
-        return TokenType::EXPORT;
-    else if (identifier == "as")
-        return TokenType::AS;
-    else if (identifier == "is")
-        return TokenType::IS;
-    else if (identifier == "in")
-        return TokenType::IN;
-    else if (identifier == "int" || identifier == "int64")
-        return TokenType::INT_TYPE;
-    else if (identifier == "int8")
-        return TokenType::INT8_TYPE;
-    else if (identifier == "int16")
-        return TokenType::INT16_TYPE;
-    else if (identifier == "int32")
-        return TokenType::INT32_TYPE;
-    else if (identifier == "float")
-        return TokenType::FLOAT_TYPE;
-    else if (identifier == "float32")
-        return TokenType::FLOAT32_TYPE;
-    else if (identifier == "str")
-        return TokenType::STRING_TYPE;
-    else if (identifier == "bool")
-        return TokenType::BOOL_TYPE;
-    else if (identifier == "void")
-        return TokenType::VOID_TYPE;
-    else if (identifier == "import")
-        return TokenType::IMPORT;
-    else if (identifier == "from")
-        return TokenType::FROM;
-    else
-        return TokenType::IDENTIFIER;
+    return GetKeywordType(identifier);
 }
\ No newline at end of file
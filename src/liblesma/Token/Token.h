@@ -8,20 +8,25 @@
 
 #include "TokenType.h"
 #include "liblesma/Common/Utils.h"
+#include <llvm/ADT/StringRef.h>
 
 namespace lesma {
+    /**
+     * Token of a source, read from a TokenBuffer, its lexeme is a view into the source buffer or the token buffer
+     */
     struct Token {
-        std::string lexeme;
+        // The decoded contents of a STRING are kept by the token buffer, and are invalid once the parser advances past it
+        llvm::StringRef lexeme;
         TokenType type = TokenType::NULL_TOKEN;
         llvm::SMRange span;
 
         Token() = default;
-        Token(const TokenType &type, std::string lexeme, llvm::SMRange span) : lexeme(std::move(lexeme)), type(type), span(span) {}
+        Token(const TokenType &type, llvm::StringRef lexeme, llvm::SMRange span) : lexeme(lexeme), type(type), span(span) {}
 
         [[nodiscard]] llvm::SMLoc getStart() const { return span.Start; }
         [[nodiscard]] llvm::SMLoc getEnd() const { return span.End; };
 
-        static TokenType GetIdentifierType(const std::string &identifier, Token *lastTok);
+        static TokenType GetIdentifierType(llvm::StringRef identifier, TokenType lastType);
         [[nodiscard]] std::string Dump(const std::shared_ptr<llvm::SourceMgr> &srcMgr) const;
 
         bool operator==(const Token &rhs) const {
@@ -0,0 +1,83 @@
+#include "TokenBuffer.h"
+
+using namespace lesma;
+
+void TokenBuffer::Add(TokenType type, llvm::SMRange span) {
+    types.push_back(type);
+    offsets.push_back(static_cast<uint32_t>(span.Start.getPointer() - source.data()));
+    lengths.push_back(static_cast<uint32_t>(span.End.getPointer() - span.Start.getPointer()));
+}
+
+void TokenBuffer::AddString(llvm::SMRange span, llvm::StringRef contents) {
+    auto &string = strings[static_cast<uint32_t>(size())];
+    string = contents.str();
+    string_bytes += string.capacity();
+    Add(TokenType::STRING, span);
+}
+
+void TokenBuffer::PopBack() {
+    if (types.back() == TokenType::STRING)
+        EraseString(size() - 1);
+
+    types.pop_back();
+    offsets.pop_back();
+    lengths.pop_back();
+}
+
+/**
+ * Release the tokens before an index, which won't be read anymore. They're dropped in batches of at least half of
+ * the tokens kept, so moving the tokens left is amortized over the ones released.
+ *
+ * @param index Index of the first token still read
+ */
+void TokenBuffer::Release(size_t index) {
+    const size_t min_batch = 4096;
+    if (index <= first || index - first < min_batch || (index - first) * 2 < types.size())
+        return;
+
+    auto count = index - first;
+    for (size_t i = 0; i < count; i++)
+        if (types[i] == TokenType::STRING)
+            EraseString(first + i);
+
+    types.erase(types.begin(), types.begin() + count);
+    offsets.erase(offsets.begin(), offsets.begin() + count);
+    lengths.erase(lengths.begin(), lengths.begin() + count);
+    first = index;
+}
+
+void TokenBuffer::EraseString(size_t i) {
+    auto string = strings.find(static_cast<uint32_t>(i));
+    if (string == strings.end())
+        return;
+
+    string_bytes -= string->second.capacity();
+    strings.erase(string);
+}
+
+llvm::SMRange TokenBuffer::getSpan(size_t i) const {
+    auto start = source.data() + offsets[i - first];
+    return {llvm::SMLoc::getFromPointer(start), llvm::SMLoc::getFromPointer(start + lengths[i - first])};
+}
+
+llvm::StringRef TokenBuffer::getLexeme(size_t i) const {
+    switch (getType(i)) {
+        case TokenType::STRING:
+            return strings.at(static_cast<uint32_t>(i));
+        case TokenType::NEWLINE:
+            return "NEWLINE";
+        case TokenType::INDENT:
+            return "INDENT";
+        case TokenType::DEDENT:
+            return "DEDENT";
+        case TokenType::EOF_TOKEN:
+            return "EOF";
+        default:
+            return source.substr(offsets[i - first], lengths[i - first]);
+    }
+}
+
+size_t TokenBuffer::getMemorySize() const {
+    return types.capacity() * sizeof(TokenType) + offsets.capacity() * sizeof(uint32_t) + lengths.capacity() * sizeof(uint32_t) +
+           strings.bucket_count() * sizeof(void *) + strings.size() * sizeof(decltype(strings)::value_type) + string_bytes;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <llvm/ADT/StringRef.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Token.h"
+
+namespace lesma {
+    /**
+     * Tokens of a source buffer, stored as parallel arrays of their types and of the 32-bit offset and length of their
+     * span in the buffer. Lexemes are views of the buffer, except for the decoded contents of string literals, which
+     * the token buffer keeps until they're released, and for the tokens made up by the lexer, which are named after their type.
+     * Tokens are indexed from the start of the buffer, even once the ones before an index were released.
+     */
+    class TokenBuffer {
+    public:
+        explicit TokenBuffer(llvm::StringRef source) : source(source) {}
+
+        TokenBuffer(const TokenBuffer &) = delete;
+        TokenBuffer &operator=(const TokenBuffer &) = delete;
+
+        void Add(TokenType type, llvm::SMRange span);
+        void AddString(llvm::SMRange span, llvm::StringRef contents);
+        void PopBack();
+        void Release(size_t index);
+
+        [[nodiscard]] size_t size() const { return first + types.size(); }
+        [[nodiscard]] bool empty() const { return size() == 0; }
+        [[nodiscard]] size_t getFirst() const { return first; }
+        [[nodiscard]] TokenType getType(size_t i) const { return types[i - first]; }
+        [[nodiscard]] TokenType getLastType() const { return types.back(); }
+        [[nodiscard]] llvm::SMRange getSpan(size_t i) const;
+        [[nodiscard]] llvm::StringRef getLexeme(size_t i) const;
+        [[nodiscard]] size_t getMemorySize() const;
+
+        Token operator[](size_t i) const { return {getType(i), getLexeme(i), getSpan(i)}; }
+
+    private:
+        llvm::StringRef source;
+        // Index of the first token kept
+        size_t first = 0;
+        std::vector<TokenType> types;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> lengths;
+
+        // Contents of the string literals by token index, freed with their token. The map is node based so the
+        // lexemes of the tokens read don't move when strings are added.
+        std::unordered_map<uint32_t, std::string> strings;
+        size_t string_bytes = 0;
+
+        void EraseString(size_t i);
+    };
+}// namespace lesma
\ No newline at end of file
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstdint>
+
 namespace lesma {
 
-    enum class TokenType {
+    enum class TokenType : uint8_t {
         // Whitespace
         NEWLINE,
         INDENT,
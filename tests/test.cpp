@@ -2,9 +2,21 @@
 
 #include "liblesma/Backend/Codegen.h"
 #include "liblesma/Common/Utils.h"
+#include "liblesma/Driver/Driver.h"
+#include "liblesma/Driver/Server.h"
+#include "liblesma/Driver/Session.h"
 #include "liblesma/Frontend/Lexer.h"
 #include "liblesma/Frontend/Parser.h"
 
+#include <filesystem>
+#include <fstream>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/Program.h>
+#include <set>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
 using namespace lesma;
@@ -26,20 +38,56 @@ static std::unique_ptr<Lexer> initializeLexer(const std::shared_ptr<SourceMgr> &
     return curLexer;
 }
 
-static std::unique_ptr<Parser> initializeParser(std::unique_ptr<Lexer> lexer) {
-    auto curParser = std::make_unique<Parser>(lexer->getTokens());
+static std::unique_ptr<Parser> initializeParser(Lexer &lexer) {
+    auto curParser = std::make_unique<Parser>(lexer);
     curParser->Parse();
 
     return curParser;
 }
 
-static Codegen *initializeCodegen(std::unique_ptr<Parser> parser, const std::shared_ptr<SourceMgr> &srcMgr) {
-    auto _codegen = new Codegen(std::move(parser), srcMgr, __FILE__, {}, true, true);
+static Codegen *initializeCodegen(std::unique_ptr<Parser> parser, const std::shared_ptr<SourceMgr> &srcMgr, const std::string &cache_dir) {
+    auto graph = std::make_shared<ModuleGraph>(OptimizationLevel::O3, CodeGenOpt::Aggressive, "generic", "", LTOKind::None, 0, cache_dir);
+    auto _codegen = new Codegen(std::move(parser), srcMgr, __FILE__, graph, true, true);
     _codegen->Run();
 
     return _codegen;
 }
 
+// Directory of the sources and outputs of a test, removed with them at the end of the test
+class TempDir {
+public:
+    TempDir() {
+        llvm::SmallString<128> dir;
+        EXPECT_FALSE(llvm::sys::fs::createUniqueDirectory("lesma-test", dir));
+        path = dir.str().str();
+    }
+    ~TempDir() {
+        std::filesystem::remove_all(path);
+    }
+
+    [[nodiscard]] std::string Path(const std::string &name) const { return (path / name).string(); }
+
+    std::string Write(const std::string &name, const std::string &contents) const {
+        std::ofstream(Path(name)) << contents;
+        return Path(name);
+    }
+
+private:
+    std::filesystem::path path;
+};
+
+// Options of a program compiled to its test directory, with the caches in the same directory
+static std::unique_ptr<Options> initializeOptions(const std::string &source, const std::string &output) {
+    auto options = std::make_unique<Options>(Options{SourceType::FILE, source});
+    options->output_filename = output;
+    options->cache_dir = (std::filesystem::path(output).parent_path() / "cache").string();
+
+    return options;
+}
+
+static int runProgram(const std::string &path) {
+    return llvm::sys::ExecuteAndWait(path, {path});
+}
 
 llvm::SMRange getRange(const std::string &source, int x, int y) {
     return {llvm::SMLoc::getFromPointer(source.c_str() + x), llvm::SMLoc::getFromPointer(source.c_str() + y)};
@@ -81,7 +129,8 @@ public:
     void SetUp() override {
         LexerTest::SetUp();
 
-        parser = initializeParser(std::move(LexerTest::lexer));
+        // The parser reads the tokens of the lexer, which is kept by the fixture
+        parser = initializeParser(*LexerTest::lexer);
     }
 
     void TearDown() override {
@@ -91,12 +140,13 @@ public:
 
 class CodegenTest : public ParserTest {
 public:
+    TempDir dir;
     Codegen *codegen = nullptr;
 
     void SetUp() override {
         ParserTest::SetUp();
 
-        codegen = initializeCodegen(std::move(ParserTest::parser), LexerTest::srcMgr);
+        codegen = initializeCodegen(std::move(ParserTest::parser), LexerTest::srcMgr, dir.Path("cache"));
     }
 
     void TearDown() override {
@@ -108,26 +158,107 @@ public:
 TEST_F(LexerTest, Tokens) {
     EXPECT_TRUE(lexer->getTokens().size() > 1);
 
-    std::vector<Token *> tokens = {
-            new Token{TokenType::VAR, "var", getRange(source, 0, 3)},
-            new Token{TokenType::IDENTIFIER, "y", getRange(source, 4, 5)},
-            new Token{TokenType::COLON, ":", getRange(source, 5, 6)},
-            new Token{TokenType::INT_TYPE, "int", getRange(source, 7, 10)},
-            new Token{TokenType::EQUAL, "=", getRange(source, 11, 12)},
-            new Token{TokenType::INTEGER, "100", getRange(source, 13, 16)},
-            new Token{TokenType::NEWLINE, "NEWLINE", getRange(source, 16, 17)},
-            new Token{TokenType::IDENTIFIER, "y", getRange(source, 17, 18)},
-            new Token{TokenType::EQUAL, "=", getRange(source, 19, 20)},
-            new Token{TokenType::INTEGER, "101", getRange(source, 21, 24)},
-            new Token{TokenType::NEWLINE, "NEWLINE", getRange(source, 24, 25)},
-            new Token{TokenType::EOF_TOKEN, "EOF", getRange(source, 25, 25)},
+    std::vector<Token> tokens = {
+            Token{TokenType::VAR, "var", getRange(source, 0, 3)},
+            Token{TokenType::IDENTIFIER, "y", getRange(source, 4, 5)},
+            Token{TokenType::COLON, ":", getRange(source, 5, 6)},
+            Token{TokenType::INT_TYPE, "int", getRange(source, 7, 10)},
+            Token{TokenType::EQUAL, "=", getRange(source, 11, 12)},
+            Token{TokenType::INTEGER, "100", getRange(source, 13, 16)},
+            Token{TokenType::NEWLINE, "NEWLINE", getRange(source, 16, 17)},
+            Token{TokenType::IDENTIFIER, "y", getRange(source, 17, 18)},
+            Token{TokenType::EQUAL, "=", getRange(source, 19, 20)},
+            Token{TokenType::INTEGER, "101", getRange(source, 21, 24)},
+            Token{TokenType::NEWLINE, "NEWLINE", getRange(source, 24, 25)},
+            Token{TokenType::EOF_TOKEN, "EOF", getRange(source, 25, 25)},
     };
 
-    for (auto [a, b]: zip(tokens, lexer->getTokens())) {
-        EXPECT_EQ(*a, *b);
+    ASSERT_EQ(tokens.size(), lexer->getTokens().size());
+    for (size_t i = 0; i < tokens.size(); i++) {
+        EXPECT_EQ(tokens[i], lexer->getTokens()[i]);
+    }
+}
+
+TEST(TokenTest, Keywords) {
+    auto last = TokenType::IDENTIFIER;
+    EXPECT_EQ(Token::GetIdentifierType("int64", last), TokenType::INT_TYPE);
+    EXPECT_EQ(Token::GetIdentifierType("import", last), TokenType::IMPORT);
+    EXPECT_EQ(Token::GetIdentifierType("return", last), TokenType::RETURN);
+    EXPECT_EQ(Token::GetIdentifierType("void", last), TokenType::VOID_TYPE);
+
+    // Identifiers sharing the length and first characters of keywords
+    EXPECT_EQ(Token::GetIdentifierType("int65", last), TokenType::IDENTIFIER);
+    EXPECT_EQ(Token::GetIdentifierType("retour", last), TokenType::IDENTIFIER);
+    EXPECT_EQ(Token::GetIdentifierType("ix", last), TokenType::IDENTIFIER);
+
+    EXPECT_EQ(Token::GetIdentifierType("if", TokenType::ELSE), TokenType::ELSE_IF);
+}
+
+TEST(LexerCorpusTest, Sources) {
+    auto corpus = std::filesystem::path(__FILE__).parent_path() / "lesma";
+    for (const auto &entry: std::filesystem::recursive_directory_iterator(corpus)) {
+        if (entry.path().extension() != ".les")
+            continue;
+
+        auto srcMgr = std::make_shared<SourceMgr>();
+        srcMgr->AddNewSourceBuffer(std::move(*MemoryBuffer::getFile(entry.path().string())), llvm::SMLoc());
+        auto lexer = initializeLexer(srcMgr);
+
+        // Tokens are views of their span of the source, except for the ones the lexer makes up
+        const auto &tokens = lexer->getTokens();
+        ASSERT_EQ(tokens.getLastType(), TokenType::EOF_TOKEN) << entry.path();
+        for (size_t i = 0; i < tokens.size(); i++) {
+            auto token = tokens[i];
+            if (token.type == TokenType::STRING || token.type == TokenType::NEWLINE || token.type == TokenType::INDENT ||
+                token.type == TokenType::DEDENT || token.type == TokenType::EOF_TOKEN)
+                continue;
+
+            auto span = llvm::StringRef(token.getStart().getPointer(), token.getEnd().getPointer() - token.getStart().getPointer());
+            EXPECT_EQ(token.lexeme, span) << entry.path();
+        }
     }
 }
 
+TEST(LexerCorpusTest, LongSkippedRuns) {
+    std::string source = "var x: int = 1\n";
+    for (int i = 0; i < 500000; i++)
+        source += "# comment\n    \n";
+    source += "x = 2" + std::string(100000, ' ') + "\n";
+
+    // Skipped characters don't grow the stack, and produce the tokens of the source without them
+    auto lexer = initializeLexer(initializeSrcMgr(source));
+    std::vector<TokenType> types;
+    for (size_t i = 0; i < lexer->getTokens().size(); i++)
+        types.push_back(lexer->getTokens().getType(i));
+
+    std::vector<TokenType> expected = {TokenType::VAR, TokenType::IDENTIFIER, TokenType::COLON, TokenType::INT_TYPE, TokenType::EQUAL,
+                                       TokenType::INTEGER, TokenType::NEWLINE, TokenType::IDENTIFIER, TokenType::EQUAL, TokenType::INTEGER,
+                                       TokenType::NEWLINE, TokenType::EOF_TOKEN};
+    EXPECT_EQ(types, expected);
+}
+
+TEST(ParserStreamingTest, ScannedSources) {
+    std::string source;
+    for (int i = 0; i < 2000; i++)
+        source += "var s" + std::to_string(i) + ": str = \"a\"\n"
+                  "if s" + std::to_string(i) + " is not int\n"
+                  "    s" + std::to_string(i) + " = \"c\"\n"
+                  "else if 1 < 2\n"
+                  "    # comment\n"
+                  "    s" + std::to_string(i) + " = \"d\"\n";
+
+    // Parsing while scanning releases the tokens read, and builds the same tree as parsing all the tokens
+    auto srcMgr = initializeSrcMgr(source);
+    auto scanned_lexer = initializeLexer(srcMgr);
+    auto scanned = initializeParser(*scanned_lexer);
+    auto lexer = std::make_unique<Lexer>(srcMgr);
+    Parser streamed(*lexer);
+    streamed.Parse();
+
+    EXPECT_GT(lexer->getTokens().getFirst(), 0u);
+    EXPECT_EQ(streamed.getAST()->toString(srcMgr.get(), "", true), scanned->getAST()->toString(srcMgr.get(), "", true));
+}
+
 TEST_F(ParserTest, AST) {
     EXPECT_EQ(parser->getAST()->getChildren().size(), 2);
     EXPECT_EQ(parser->getAST()->getChildren().at(0)->toString(srcMgr.get(), "", true), "└──VarDecl[Line(1-1):Col(1-17)]: y: int = 100\n");
@@ -143,6 +274,390 @@ TEST_F(CodegenTest, Run) {
     EXPECT_TRUE(exit_code == 0);
 }
 
+TEST(SessionTest, Lookup) {
+    TempDir dir;
+    Options options{SourceType::STRING, ""};
+    options.cache_dir = dir.Path("cache");
+    Session session(options);
+    session.Evaluate("var base: int = 40\n"
+                     "def add(x: int) -> int\n"
+                     "    return base + x\n");
+
+    auto add = session.Lookup<int64_t(int64_t)>("add");
+    ASSERT_NE(add, nullptr);
+    EXPECT_EQ(add(2), 42);
+
+    // Later sources use the functions and variables of the previous ones
+    EXPECT_EQ(session.Evaluate("base = add(2)\n"), 0);
+    EXPECT_EQ(add(0), 42);
+    EXPECT_EQ(session.Lookup("missing"), nullptr);
+}
+
+TEST(ReplTest, Inputs) {
+    TempDir dir;
+    Options options{SourceType::STRING, ""};
+    options.cache_dir = dir.Path("cache");
+    options.optimization = OptimizationLevel::O2;
+    Session session(options);
+    session.Evaluate("var total: int = 1\n");
+    session.Evaluate("def get() -> int\n    return total\n");
+
+    // Inputs failing to compile or to be added to the JIT are forgotten, their names can be defined again
+    EXPECT_THROW(session.Evaluate("def broken() -> int\n    return missing\n"), LesmaError);
+    EXPECT_THROW(session.Evaluate("def extern lesma_missing_symbol(x: int) -> int\n"
+                                  "def twice() -> int\n"
+                                  "    return lesma_missing_symbol(1)\n\n"
+                                  "twice()\n"),
+                 LesmaError);
+    session.Evaluate("def broken() -> int\n    return 3\n");
+    session.Evaluate("def twice() -> int\n    return get() * 2\n");
+
+    // Variables and functions persist across inputs
+    session.Evaluate("total = total + broken()\n");
+    auto twice = session.Lookup<int64_t()>("twice");
+    ASSERT_NE(twice, nullptr);
+    EXPECT_EQ(twice(), 8);
+}
+
+TEST(ModuleCacheTest, ChangedImport) {
+    TempDir dir;
+    ModuleCache cache(dir.Path("cache"));
+    auto target = "x86_64-unknown-linux-gnu:generic:";
+    auto opt = OptimizationLevel::O3;
+
+    // a.les imports b.les, which imports c.les, every module is cached
+    auto c = dir.Write("c.les", "export def get() -> int\n    return 1\n");
+    auto b = dir.Write("b.les", "import \"c.les\"\n\nexport def get() -> int\n    return c.get()\n");
+    auto getKey = [&](const std::string &path, const std::string &alias) {
+        return ModuleCache::getKey((*MemoryBuffer::getFile(path))->getBuffer(), alias, target, opt, LTOKind::None);
+    };
+
+    LLVMContext context;
+    Module module("Lesma", context);
+    SymbolTable scope(nullptr);
+    auto c_key = getKey(c, "c");
+    auto b_key = getKey(b, "b");
+    cache.Store(c_key, module, ModuleInterface::Create(&scope, {}));
+    cache.Store(b_key, module, ModuleInterface::Create(&scope, {{c, "c", c_key}}));
+    auto a_interface = ModuleInterface::Create(&scope, {{b, "b", b_key}});
+    EXPECT_TRUE(cache.IsUpToDate(a_interface, target, opt, LTOKind::None));
+
+    // The sources of a.les and b.les didn't change, but they're compiled again since c.les did
+    dir.Write("c.les", "export def get() -> int\n    return 2\n");
+    EXPECT_FALSE(cache.IsUpToDate(a_interface, target, opt, LTOKind::None));
+    ASSERT_TRUE(cache.LoadInterface(b_key).has_value());
+    EXPECT_FALSE(cache.IsUpToDate(*cache.LoadInterface(b_key), target, opt, LTOKind::None));
+}
+
+TEST(ModuleCacheTest, Prune) {
+    TempDir dir;
+    ModuleCache cache(dir.Path("cache"));
+    ASSERT_TRUE(cache.StoreObject("old", "object"));
+
+    // Age the object past the expiration, and forget when the cache was last pruned
+    int fd;
+    ASSERT_FALSE(llvm::sys::fs::openFileForRead(cache.getObjectPath("old"), fd));
+    llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now() - std::chrono::hours(24 * 8));
+    close(fd);
+    std::filesystem::remove(dir.Path("cache/llvmcache.timestamp"));
+
+    // Storing another object prunes the cache
+    ASSERT_TRUE(cache.StoreObject("new", "object"));
+    EXPECT_FALSE(cache.HasObject("old"));
+    EXPECT_TRUE(cache.HasObject("new"));
+}
+
+TEST(ModuleGraphTest, LoadOnce) {
+    TempDir dir;
+    auto path = dir.Write("a.les", "export def get() -> int\n    return 1\n");
+
+    // A module imported by several modules is a single node, unless it's imported with another alias
+    ModuleGraph graph;
+    auto node = graph.Load(path, "a");
+    EXPECT_EQ(graph.Load(path, "a"), node);
+    EXPECT_EQ(graph.Find(path, "a"), node);
+    EXPECT_NE(graph.Load(path, "b"), node);
+    EXPECT_EQ(graph.getNodes().size(), 2);
+}
+
+TEST(DriverTest, CircularImport) {
+    TempDir dir;
+    dir.Write("b.les", "import \"a.les\"\n\nexport def get() -> int\n    return 1\n");
+    auto a = dir.Write("a.les", "import \"b.les\"\n\nexport def get() -> int\n    return b.get()\n");
+
+    EXPECT_NE(Driver::Compile(initializeOptions(a, dir.Path("a"))), 0);
+    EXPECT_FALSE(std::filesystem::exists(dir.Path("a")));
+}
+
+TEST(DriverTest, ImportOrder) {
+    TempDir dir;
+    // d.les is imported by b.les and c.les, which are both imported by a.les, every module is compiled after its imports
+    dir.Write("d.les", "export def get() -> int\n    return 1\n");
+    dir.Write("b.les", "import \"d.les\"\n\nexport def getB() -> int\n    return d.get() + 1\n");
+    dir.Write("c.les", "import \"d.les\"\n\nexport def getC() -> int\n    return d.get() + 2\n");
+    auto a = dir.Write("a.les", "import \"b.les\"\nimport \"c.les\"\n\nexit(b.getB() + c.getC())\n");
+
+    ASSERT_EQ(Driver::Compile(initializeOptions(a, dir.Path("a"))), 0);
+    EXPECT_EQ(runProgram(dir.Path("a")), 5);
+}
+
+TEST(DriverTest, Partitions) {
+    TempDir dir;
+    auto source = dir.Write("a.les", "def double(x: int) -> int\n    return x * 2\n\n"
+                                     "def triple(x: int) -> int\n    return x * 3\n\n"
+                                     "exit(double(2) + triple(3))\n");
+
+    // The functions are split between partitions compiled in parallel, the program behaves the same
+    for (unsigned partitions: {1, 4}) {
+        auto output = dir.Path(fmt::format("a{}", partitions));
+        auto options = initializeOptions(source, output);
+        options->partitions = partitions;
+
+        ASSERT_EQ(Driver::Compile(std::move(options)), 0);
+        EXPECT_EQ(runProgram(output), 13);
+    }
+}
+
+TEST(JITObjectCacheTest, Hit) {
+    TempDir dir;
+    JITObjectCache cache("x86_64-unknown-linux-gnu:generic:", dir.Path("jit"));
+    LLVMContext context;
+    Module module("Lesma", context);
+
+    // The object of a module is stored once it's compiled, and loaded instead of compiling it next time
+    EXPECT_EQ(cache.getObject(&module), nullptr);
+    cache.notifyObjectCompiled(&module, MemoryBufferRef("object", "lesma.o"));
+    auto object = cache.getObject(&module);
+    ASSERT_NE(object, nullptr);
+    EXPECT_EQ(object->getBuffer(), "object");
+
+    // Another module isn't found, nor is an excluded module
+    Module other("Lesma", context);
+    Function::Create(FunctionType::get(llvm::Type::getVoidTy(context), false), GlobalValue::ExternalLinkage, "f", other);
+    EXPECT_EQ(cache.getObject(&other), nullptr);
+    cache.Exclude(&module);
+    EXPECT_EQ(cache.getObject(&module), nullptr);
+}
+
+TEST(DriverTest, OptimizationLevels) {
+    TempDir dir;
+    auto source = dir.Write("a.les", "def fib(n: int) -> int\n    if n < 2\n        return n\n    return fib(n - 1) + fib(n - 2)\n\n"
+                                     "exit(fib(10))\n");
+
+    auto levels = {OptimizationLevel::O0, OptimizationLevel::O1, OptimizationLevel::O2, OptimizationLevel::O3, OptimizationLevel::Os, OptimizationLevel::Oz};
+    for (const auto &level: levels) {
+        auto output = dir.Path(fmt::format("a{}{}", level.getSpeedupLevel(), level.getSizeLevel()));
+        auto options = initializeOptions(source, output);
+        options->optimization = level;
+
+        ASSERT_EQ(Driver::Compile(std::move(options)), 0);
+        EXPECT_EQ(runProgram(output), 55);
+    }
+}
+
+TEST(DriverTest, Multiversion) {
+    TempDir dir;
+    auto source = dir.Write("a.les", "def fib(n: int) -> int\n    if n < 2\n        return n\n    return fib(n - 1) + fib(n - 2)\n\n"
+                                     "exit(fib(10))\n");
+
+    // The variant for the features of the host is called, or the default one
+    auto options = initializeOptions(source, dir.Path("a"));
+    options->multiversion = {"avx2", "avx512f"};
+    ASSERT_EQ(Driver::Compile(std::move(options)), 0);
+    EXPECT_EQ(runProgram(dir.Path("a")), 55);
+
+    options = initializeOptions(source, dir.Path("b"));
+    options->multiversion = {"unknown"};
+    EXPECT_NE(Driver::Compile(std::move(options)), 0);
+}
+
+TEST(DriverTest, MultiversionCalls) {
+    TempDir dir;
+    std::string source = "def fib(n: int) -> int\n    if n < 2\n        return n\n    return fib(n - 1) + fib(n - 2)\n\n"
+                         "exit(fib(10))\n";
+    auto srcMgr = initializeSrcMgr(source);
+    auto lexer = initializeLexer(srcMgr);
+    auto graph = std::make_shared<ModuleGraph>(OptimizationLevel::O0, CodeGenOpt::None, "generic", "", LTOKind::None, 0, dir.Path("cache"));
+    Codegen codegen(initializeParser(*lexer), srcMgr, __FILE__, graph, false, true);
+    codegen.Run();
+    codegen.MultiversionFunctions({"avx2"});
+
+    testing::internal::CaptureStdout();
+    codegen.Dump();
+    llvm::outs().flush();
+    auto ir = testing::internal::GetCapturedStdout();
+
+    // The top-level code calls the ifunc, the recursive calls stay within their variant
+    EXPECT_NE(ir.find("call i64 @\".fib:i\"(i64 10)"), std::string::npos);
+    EXPECT_NE(ir.find("call i64 @\".fib:i.default\"(i64 %4)"), std::string::npos);
+    EXPECT_NE(ir.find("call i64 @\".fib:i.avx2\"(i64 %4)"), std::string::npos);
+    EXPECT_EQ(ir.find("call i64 @\".fib:i\"(i64 %"), std::string::npos);
+}
+
+TEST(DriverTest, LinkTwice) {
+    TempDir dir;
+    auto source = dir.Write("a.les", "exit(3)\n");
+
+    // LLD links every program in this process
+    for (auto name: {"a", "b"}) {
+        ASSERT_EQ(Driver::Compile(initializeOptions(source, dir.Path(name))), 0);
+        EXPECT_EQ(runProgram(dir.Path(name)), 3);
+    }
+}
+
+TEST(DriverTest, LinkTimeOptimization) {
+    TempDir dir;
+    dir.Write("b.les", "export def double(x: int) -> int\n    return x * 2\n");
+    auto a = dir.Write("a.les", "import \"b.les\"\n\nexit(b.double(21))\n");
+
+    // The imported module is optimized together with the main module
+    for (auto lto: {LTOKind::Full, LTOKind::Thin}) {
+        auto output = dir.Path(fmt::format("a{}", static_cast<int>(lto)));
+        auto options = initializeOptions(a, output);
+        options->lto = lto;
+
+        ASSERT_EQ(Driver::Compile(std::move(options)), 0);
+        EXPECT_EQ(runProgram(output), 42);
+    }
+}
+
+TEST(DriverTest, CompileAll) {
+    TempDir dir;
+    dir.Write("c.les", "export def triple(x: int) -> int\n    return x * 3\n");
+
+    // The programs share an import and split their own modules into partitions, within their share of the cores
+    std::vector<std::unique_ptr<Options>> options;
+    for (int i = 1; i <= 4; i++) {
+        auto name = fmt::format("p{}", i);
+        auto source = dir.Write(name + ".les", fmt::format("import \"c.les\"\n\nexit(c.triple({}))\n", i));
+        options.push_back(initializeOptions(source, dir.Path(name)));
+        options.back()->partitions = 2;
+        options.back()->mem_report = true;
+    }
+
+    // The memory report counts every program of the process, it's turned off
+    ASSERT_EQ(Driver::CompileAll(std::move(options), 2), 0);
+    EXPECT_FALSE(MemoryReport::isEnabled());
+    for (int i = 1; i <= 4; i++)
+        EXPECT_EQ(runProgram(dir.Path(fmt::format("p{}", i))), i * 3);
+}
+
+TEST(DriverTest, Incremental) {
+    TempDir dir;
+    auto getObjects = [&] {
+        std::set<std::string> objects;
+        std::error_code err;
+        for (const auto &entry: std::filesystem::directory_iterator(dir.Path("cache"), err)) {
+            if (entry.path().extension() == ".o")
+                objects.insert(entry.path().string());
+        }
+        return objects;
+    };
+
+    auto write = [&](int offset) {
+        return dir.Write("a.les", fmt::format("def scale(x: int) -> int\n"
+                                              "    return x * 2\n\n"
+                                              "def offset(x: int) -> int\n"
+                                              "    return x - 2 + {}\n\n"
+                                              "exit(offset(scale(1)) + 5)\n",
+                                              offset));
+    };
+    auto compile = [&](const std::string &source) {
+        auto options = initializeOptions(source, dir.Path("a"));
+        options->incremental = true;
+        return Driver::Compile(std::move(options));
+    };
+
+    // Every function, and the standard library, misses the empty cache of the test
+    ASSERT_EQ(compile(write(0)), 0);
+    EXPECT_EQ(runProgram(dir.Path("a")), 5);
+    EXPECT_EQ(getObjects().size(), 4);
+
+    // Only the edited function misses the cache, the other function and the top-level code are reused
+    auto objects = getObjects();
+    ASSERT_EQ(compile(write(1)), 0);
+    EXPECT_EQ(runProgram(dir.Path("a")), 6);
+
+    std::vector<std::string> added;
+    for (const auto &object: getObjects()) {
+        if (objects.count(object) == 0)
+            added.push_back(object);
+    }
+    EXPECT_EQ(added.size(), 1);
+}
+
+TEST(DriverTest, TimeTrace) {
+    TempDir dir;
+    auto source = dir.Write("a.les", "def get() -> int\n    return 4\n\nexit(get())\n");
+    auto options = initializeOptions(source, dir.Path("a"));
+    options->time_trace = dir.Path("trace.json");
+    options->time_trace_granularity = 0;
+    ASSERT_EQ(Driver::Compile(std::move(options)), 0);
+
+    // The trace is a Chrome trace, a JSON object with the traced events
+    auto buffer = MemoryBuffer::getFile(dir.Path("trace.json"));
+    ASSERT_TRUE(buffer);
+    auto trace = llvm::json::parse((*buffer)->getBuffer());
+    ASSERT_TRUE(bool(trace)) << llvm::toString(trace.takeError());
+    ASSERT_NE(trace->getAsObject(), nullptr);
+    auto events = trace->getAsObject()->getArray("traceEvents");
+    ASSERT_NE(events, nullptr);
+    EXPECT_FALSE(events->empty());
+}
+
+TEST(DriverTest, DiscoverCachedImports) {
+    TempDir dir;
+    dir.Write("b.les", "export def double(x: int) -> int\n    return x * 2\n");
+    auto source = dir.Write("a.les", "import \"b.les\"\n\nexit(b.double(21))\n");
+
+    // Imports are only scanned until their interfaces are cached, then their dependencies are imported instead
+    for (auto [name, scanned]: {std::pair("a", 2), std::pair("b", 0)}) {
+        auto options = initializeOptions(source, dir.Path(name));
+        options->time_trace = dir.Path("trace.json");
+        options->time_trace_granularity = 0;
+        ASSERT_EQ(Driver::Compile(std::move(options)), 0);
+        EXPECT_EQ(runProgram(dir.Path(name)), 42);
+
+        auto buffer = MemoryBuffer::getFile(dir.Path("trace.json"));
+        ASSERT_TRUE(buffer);
+        auto trace = llvm::json::parse((*buffer)->getBuffer());
+        ASSERT_TRUE(bool(trace)) << llvm::toString(trace.takeError());
+        int scans = 0;
+        for (const auto &event: *trace->getAsObject()->getArray("traceEvents")) {
+            if (event.getAsObject()->getString("name") == llvm::StringRef("Scan imports"))
+                scans++;
+        }
+        EXPECT_EQ(scans, scanned) << name;
+    }
+}
+
+TEST(ServerTest, Forward) {
+    TempDir dir;
+    auto socket = dir.Path("server.sock");
+    EXPECT_EQ(Server::Forward(socket, {"lesma", "run", "a.les"}), std::nullopt);
+
+    // The server runs until it's killed, requests are handled in the working directory of the client
+    auto cwd = std::filesystem::current_path();
+    auto server = fork();
+    ASSERT_GE(server, 0);
+    if (server == 0) {
+        exit(Server::Serve(socket, [&cwd](const std::vector<std::string> &args) {
+            return args == std::vector<std::string>{"lesma", "run", "a.les"} && std::filesystem::current_path() == cwd ? 7 : 1;
+        }));
+    }
+
+    std::optional<int> exit_code;
+    for (int attempt = 0; attempt < 100 && !exit_code.has_value(); attempt++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        exit_code = Server::Forward(socket, {"lesma", "run", "a.les"});
+    }
+    EXPECT_EQ(exit_code, 7);
+    EXPECT_EQ(Server::Forward(socket, {"lesma", "compile", "a.les"}), 1);
+
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+}
+
 // Google Test main function
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);